@@ -0,0 +1,135 @@
+// compares fifo and lifo id reuse on a churn workload over a payload array indexed by id: every iteration destroys a
+// random live object and creates a new one, with lifo reuse the new object lands in the slot that was just touched.
+//
+// build from the repository root with the generated sbpt includes on the include path, e.g.
+//     g++ -std=c++20 -O2 -I. benchmarks/reuse_locality_benchmark.cpp unique_id_generator.cpp -o reuse_locality_benchmark
+
+#include "../unique_id_generator.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+struct Payload {
+    std::uint64_t fields[8]; ///< one cache line per object.
+};
+
+/**
+ * @brief counts last level cache misses of the calling thread, reports nothing where perf events are unavailable.
+ */
+class CacheMissCounter {
+  public:
+    CacheMissCounter() {
+#ifdef __linux__
+        perf_event_attr attributes{};
+        attributes.type = PERF_TYPE_HARDWARE;
+        attributes.size = sizeof(attributes);
+        attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+        attributes.disabled = 1;
+        attributes.exclude_kernel = 1;
+        attributes.exclude_hv = 1;
+        file_descriptor = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+#endif
+    }
+
+    ~CacheMissCounter() {
+#ifdef __linux__
+        if (file_descriptor >= 0) {
+            close(file_descriptor);
+        }
+#endif
+    }
+
+    void start() {
+#ifdef __linux__
+        if (file_descriptor >= 0) {
+            ioctl(file_descriptor, PERF_EVENT_IOC_RESET, 0);
+            ioctl(file_descriptor, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    /**
+     * @return the misses since start, or -1 if they cannot be counted.
+     */
+    long long stop() {
+#ifdef __linux__
+        long long count = 0;
+        if (file_descriptor >= 0 && ioctl(file_descriptor, PERF_EVENT_IOC_DISABLE, 0) == 0 &&
+            read(file_descriptor, &count, sizeof(count)) == sizeof(count)) {
+            return count;
+        }
+#endif
+        return -1;
+    }
+
+  private:
+    int file_descriptor = -1;
+};
+
+template <typename ReusePolicy> void run_churn(const char *name, std::size_t live_count, std::size_t iterations) {
+    // bitmap storage keeps the generator's own bookkeeping small, so the payload accesses dominate.
+    basic_id_generator<int, ReusePolicy, bitmap_storage<int>> generator(static_cast<int>(2 * live_count));
+    std::vector<Payload> payloads(2 * live_count);
+    std::vector<int> ids(2 * live_count);
+    generator.get_ids(ids.size(), ids);
+    for (int id : ids) {
+        payloads[id].fields[0] = static_cast<std::uint64_t>(id);
+    }
+
+    // half of the ids are reclaimed in random order, so the reuse policy has a large pool to choose from.
+    std::mt19937_64 random(42);
+    std::shuffle(ids.begin(), ids.end(), random);
+    generator.reclaim_ids(std::span<const int>(ids).subspan(live_count));
+    std::vector<int> live_ids(ids.begin(), ids.begin() + live_count);
+
+    std::uniform_int_distribution<std::size_t> pick(0, live_count - 1);
+    std::uint64_t checksum = 0;
+    CacheMissCounter cache_misses;
+
+    auto start = std::chrono::steady_clock::now();
+    cache_misses.start();
+    for (std::size_t i = 0; i < iterations; ++i) {
+        std::size_t victim = pick(random);
+        int destroyed_id = live_ids[victim];
+        checksum += payloads[destroyed_id].fields[0];
+        payloads[destroyed_id].fields[0] = 0;
+        generator.reclaim_id(destroyed_id);
+
+        int created_id = generator.get_id();
+        Payload &created = payloads[created_id];
+        for (std::uint64_t &field : created.fields) {
+            field = i;
+        }
+        live_ids[victim] = created_id;
+    }
+    long long misses = cache_misses.stop();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::printf("%-6s live=%-9zu %8.2f ns/iteration", name, live_count, seconds * 1e9 / iterations);
+    if (misses >= 0) {
+        std::printf("  %6.3f cache misses/iteration", static_cast<double>(misses) / iterations);
+    }
+    std::printf("  (checksum %llu)\n", static_cast<unsigned long long>(checksum));
+}
+
+} // namespace
+
+int main() {
+    const std::size_t iterations = 2000000;
+    for (std::size_t live_count : {std::size_t(1) << 14, std::size_t(1) << 18, std::size_t(1) << 21}) {
+        run_churn<fifo_reuse<int>>("fifo", live_count, iterations);
+        run_churn<lifo_reuse<int>>("lifo", live_count, iterations);
+    }
+    return 0;
+}
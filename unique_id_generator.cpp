@@ -1,10 +1,267 @@
 #include "unique_id_generator.hpp"
 
-int GlobalUIDGenerator::current_id = 0;
-int GlobalUIDGenerator::last_generated_id = 0;
+#include <chrono>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+alignas(cache_line_size) std::atomic<std::uint64_t> GlobalUIDGenerator::current_id{0};
+alignas(cache_line_size) std::atomic<std::uint64_t> GlobalUIDGenerator::last_generated_id{0};
+alignas(cache_line_size) std::atomic<std::uint64_t> GlobalUIDGenerator::lease_block_size{0};
+alignas(cache_line_size) std::atomic<std::uint64_t> GlobalUIDGenerator::persisted_bound{
+    std::numeric_limits<std::uint64_t>::max()};
+
+namespace {
+
+/**
+ * @brief the journal holds two of these slots which are written alternately, so a torn write can only ever damage the
+ * slot that is not holding the latest complete bound.
+ */
+struct JournalRecord {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint64_t bound;
+    std::uint64_t checksum;
+};
+
+constexpr std::uint32_t journal_magic = 0x4a444955; ///< "UIDJ"
+constexpr std::uint32_t journal_version = 1;
+constexpr long journal_slot_count = 2;
+
+std::uint64_t journal_checksum(std::uint64_t bound) {
+    std::uint64_t hash = (bound ^ journal_magic) * 0x9e3779b97f4a7c15ULL;
+    return hash ^ (hash >> 31);
+}
+
+struct Journal {
+    std::mutex mutex;
+    std::FILE *file = nullptr;
+    std::uint64_t block_size = 0;
+    std::uint64_t bound = 0;
+    long next_slot = 0;
+
+    void close() {
+        if (file != nullptr) {
+            std::fclose(file);
+            file = nullptr;
+        }
+    }
+
+    void write_bound(std::uint64_t new_bound) {
+        JournalRecord record{journal_magic, journal_version, new_bound, journal_checksum(new_bound)};
+        bool written = std::fseek(file, next_slot * static_cast<long>(sizeof(JournalRecord)), SEEK_SET) == 0 &&
+                       std::fwrite(&record, sizeof(record), 1, file) == 1 && std::fflush(file) == 0;
+#ifdef _WIN32
+        written = written && _commit(_fileno(file)) == 0;
+#else
+        written = written && fsync(fileno(file)) == 0;
+#endif
+        if (!written) {
+            throw std::runtime_error("Failed to write the GlobalUIDGenerator journal");
+        }
+        bound = new_bound;
+        next_slot = (next_slot + 1) % journal_slot_count;
+    }
+};
+
+Journal journal;
+
+/**
+ * @brief makes the directory entry of a newly created journal durable, fsyncing the file only covers its contents.
+ * @note a no-op on windows, where the file system journals the entry itself.
+ */
+void sync_parent_directory(const std::string &journal_path) {
+#ifndef _WIN32
+    std::string::size_type slash = journal_path.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "." : journal_path.substr(0, slash == 0 ? 1 : slash);
+    int descriptor = open(directory.c_str(), O_RDONLY);
+    bool synced = descriptor >= 0 && fsync(descriptor) == 0;
+    if (descriptor >= 0) {
+        ::close(descriptor);
+    }
+    if (!synced) {
+        throw std::runtime_error("Failed to sync the directory of GlobalUIDGenerator journal " + journal_path);
+    }
+#else
+    (void)journal_path;
+#endif
+}
+
+} // namespace
+
+/**
+ * @brief the block of ids [next, end) currently leased by a thread.
+ */
+struct GlobalUIDGenerator::ThreadLease {
+    std::uint64_t next = 0;
+    std::uint64_t end = 0;
+
+    ~ThreadLease() {
+        if (next == end) {
+            return;
+        }
+        // only possible while our block is still the last one reserved, otherwise the remainder is dropped.
+        std::uint64_t expected = end - 1;
+        current_id.compare_exchange_strong(expected, next - 1, std::memory_order_relaxed);
+    }
+};
+
+std::uint64_t GlobalUIDGenerator::reserve_ids(std::uint64_t count) {
+    // sequentially consistent to pair with enable_persistence, this costs nothing extra on x86.
+    std::uint64_t first = current_id.fetch_add(count, std::memory_order_seq_cst) + 1;
+    std::uint64_t last = first + count - 1;
+    if (last > persisted_bound.load(std::memory_order_seq_cst)) {
+        persist_through(last);
+    }
+    return first;
+}
+
+void GlobalUIDGenerator::persist_through(std::uint64_t id) {
+    std::lock_guard lock(journal.mutex);
+    if (journal.file == nullptr || id <= journal.bound) {
+        return;
+    }
+    journal.write_bound(std::max(journal.bound + journal.block_size, id));
+    persisted_bound.store(journal.bound, std::memory_order_release);
+}
+
+std::uint64_t GlobalUIDGenerator::get_id64() {
+    // checked before the block size, so a block leased before leasing was turned off is still used up first.
+    thread_local ThreadLease lease;
+    if (lease.next != lease.end) {
+        return lease.next++;
+    }
+
+    std::uint64_t block_size = lease_block_size.load(std::memory_order_relaxed);
+    if (block_size == 0) {
+        std::uint64_t id = reserve_ids(1);
+        last_generated_id.store(id, std::memory_order_relaxed);
+        return id;
+    }
+    lease.next = reserve_ids(block_size);
+    lease.end = lease.next + block_size;
+    return lease.next++;
+}
 
 int GlobalUIDGenerator::get_id() {
-    current_id += 1;
-    last_generated_id = current_id;
-    return current_id;
+    std::uint64_t id = get_id64();
+    if (id > static_cast<std::uint64_t>(std::numeric_limits<int>::max())) {
+        throw std::overflow_error("GlobalUIDGenerator id " + std::to_string(id) + " does not fit in an int");
+    }
+    return static_cast<int>(id);
+}
+
+void GlobalUIDGenerator::set_lease_block_size(std::uint64_t block_size) {
+    lease_block_size.store(block_size, std::memory_order_relaxed);
+}
+
+void GlobalUIDGenerator::enable_persistence(const std::string &journal_path, std::uint64_t block_size) {
+    if (block_size == 0) {
+        throw std::invalid_argument("Journal block_size must be greater than 0");
+    }
+
+    std::lock_guard lock(journal.mutex);
+    persisted_bound.store(std::numeric_limits<std::uint64_t>::max(), std::memory_order_release);
+    journal.close();
+
+    std::uint64_t bound = 0;
+    long next_slot = 0;
+    std::FILE *file = std::fopen(journal_path.c_str(), "r+b");
+    if (file != nullptr) {
+        bool found_record = false;
+        bool empty = true;
+        for (long slot = 0; slot < journal_slot_count; ++slot) {
+            JournalRecord record;
+            std::size_t bytes_read = std::fread(&record, 1, sizeof(record), file);
+            empty = empty && bytes_read == 0;
+            if (bytes_read != sizeof(record)) {
+                break;
+            }
+            if (record.magic == journal_magic && record.version == journal_version &&
+                record.checksum == journal_checksum(record.bound) && (!found_record || record.bound > bound)) {
+                found_record = true;
+                bound = record.bound;
+                next_slot = (slot + 1) % journal_slot_count;
+            }
+        }
+        if (!found_record && !empty) {
+            std::fclose(file);
+            throw std::runtime_error("GlobalUIDGenerator journal " + journal_path + " holds no valid record");
+        }
+    } else {
+        file = std::fopen(journal_path.c_str(), "w+b");
+        if (file == nullptr) {
+            throw std::runtime_error("Failed to open GlobalUIDGenerator journal " + journal_path);
+        }
+        try {
+            sync_parent_directory(journal_path);
+        } catch (...) {
+            std::fclose(file);
+            throw;
+        }
+    }
+
+    journal.file = file;
+    journal.block_size = block_size;
+    journal.bound = bound;
+    journal.next_slot = next_slot;
+
+    // from here on every reserve_ids waits on the journal, the store and the counter read below are sequentially
+    // consistent so an id reserved concurrently is either seen in the counter or waits for the first bound.
+    persisted_bound.store(0, std::memory_order_seq_cst);
+    std::uint64_t current = current_id.load(std::memory_order_seq_cst);
+    while (current < bound && !current_id.compare_exchange_weak(current, bound, std::memory_order_relaxed)) {
+    }
+    // ids up to the current counter may already have been handed out, so they are covered before any new one.
+    try {
+        journal.write_bound(std::max(bound, current_id.load(std::memory_order_relaxed)) + block_size);
+    } catch (...) {
+        journal.close();
+        persisted_bound.store(std::numeric_limits<std::uint64_t>::max(), std::memory_order_release);
+        throw;
+    }
+    persisted_bound.store(journal.bound, std::memory_order_release);
+}
+
+void GlobalUIDGenerator::disable_persistence() {
+    std::lock_guard lock(journal.mutex);
+    persisted_bound.store(std::numeric_limits<std::uint64_t>::max(), std::memory_order_release);
+    journal.close();
+}
+
+SnowflakeIDGenerator::SnowflakeIDGenerator(std::uint32_t node_id, std::uint64_t epoch_ms)
+    : node_id(node_id), epoch_ms(epoch_ms) {
+    if (node_id >= (std::uint32_t(1) << node_bits)) {
+        throw std::invalid_argument("Snowflake node id " + std::to_string(node_id) + " does not fit in " +
+                                    std::to_string(node_bits) + " bits");
+    }
+}
+
+std::uint64_t SnowflakeIDGenerator::milliseconds_since_epoch() const {
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    auto now_ms = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(now).count());
+    return now_ms > epoch_ms ? now_ms - epoch_ms : 0;
+}
+
+std::uint64_t SnowflakeIDGenerator::get_id() {
+    std::uint64_t now_state = milliseconds_since_epoch() << sequence_bits;
+    std::uint64_t last = last_state.load(std::memory_order_relaxed);
+    std::uint64_t next;
+    do {
+        // a sequence overflow carries into the millisecond, which borrows from the next one.
+        next = now_state > last ? now_state : last + 1;
+    } while (!last_state.compare_exchange_weak(last, next, std::memory_order_relaxed));
+
+    std::uint64_t milliseconds = next >> sequence_bits;
+    if (milliseconds >= (std::uint64_t(1) << timestamp_bits)) {
+        throw std::overflow_error("Snowflake timestamp no longer fits in " + std::to_string(timestamp_bits) + " bits");
+    }
+    std::uint64_t sequence = next & ((std::uint64_t(1) << sequence_bits) - 1);
+    return (milliseconds << (node_bits + sequence_bits)) | (static_cast<std::uint64_t>(node_id) << sequence_bits) |
+           sequence;
 }
@@ -1,152 +1,3948 @@
 #ifndef UNIQUE_ID_GENERATOR_HPP
 #define UNIQUE_ID_GENERATOR_HPP
 
-#include <queue>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
 #include <stdexcept>
 #include <unordered_set>
+#include <deque>
 #include <iostream>
+#include <span>
 #include <sstream>
 #include <limits>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <set>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
 
 #include "sbpt_generated_includes.hpp"
 
-// everything below is deprecated but existings for legacy reasons.
+/**
+ * @brief the assumed size of a cache line, used to keep independently written atomics from false sharing.
+ */
+inline constexpr std::size_t cache_line_size = 64;
+
+namespace id_generator_detail {
+
+struct FreeDeleter {
+    void operator()(void *pointer) const { std::free(pointer); }
+};
+
+template <typename T> using ZeroedArray = std::unique_ptr<T[], FreeDeleter>;
+
+/**
+ * @brief allocates count zeroed elements with calloc, large requests are served straight from fresh zero pages by the
+ * operating system so the cost does not depend on count.
+ */
+template <typename T> ZeroedArray<T> allocate_zeroed(std::size_t count) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    auto *pointer = static_cast<T *>(std::calloc(count == 0 ? 1 : count, sizeof(T)));
+    if (pointer == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ZeroedArray<T>(pointer);
+}
+
+template <typename IdT> IdT align_up(IdT value, IdT alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+/**
+ * @brief returns whether 0 <= id < end without tripping unsigned comparison warnings.
+ */
+template <typename IdT> bool in_range(IdT id, IdT end) {
+    if constexpr (std::is_signed_v<IdT>) {
+        if (id < 0) {
+            return false;
+        }
+    }
+    return id < end;
+}
+
+/**
+ * @brief the mask of the bits [first % 64, first % 64 + count) of a word, count must be in [1, 64].
+ */
+inline std::uint64_t bit_mask(std::size_t first, std::size_t count) {
+    return (~std::uint64_t(0) >> (64 - count)) << (first % 64);
+}
+
+/**
+ * @brief sets (value true) or clears the bits [first, end) of words, a whole word at a time.
+ */
+inline void fill_bits(std::uint64_t *words, std::size_t first, std::size_t end, bool value) {
+    while (first < end) {
+        std::size_t word_end = std::min(end, (first / 64 + 1) * 64);
+        std::uint64_t mask = bit_mask(first, word_end - first);
+        words[first / 64] = value ? words[first / 64] | mask : words[first / 64] & ~mask;
+        first = word_end;
+    }
+}
+
+/**
+ * @brief the lowest index in [from, end) whose bit in words differs from the matching bit of flip, or end if there is
+ * none, whole words are skipped at a time.
+ */
+inline std::size_t find_next_bit(const std::uint64_t *words, std::size_t from, std::size_t end, std::uint64_t flip) {
+    if (from >= end) {
+        return end;
+    }
+    std::size_t word_index = from / 64;
+    std::uint64_t word = (words[word_index] ^ flip) & (~std::uint64_t(0) << (from % 64));
+    while (word == 0) {
+        if (++word_index * 64 >= end) {
+            return end;
+        }
+        word = words[word_index] ^ flip;
+    }
+    return std::min(end, word_index * 64 + std::countr_zero(word));
+}
+
+/**
+ * @brief hints that the cache line holding address is about to be written.
+ */
+inline void prefetch_for_write(const void *address) {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address, 1);
+#else
+    (void)address;
+#endif
+}
+
+/**
+ * @brief the binary snapshot format is the raw host byte order of these fixed width fields.
+ */
+inline constexpr std::uint32_t snapshot_magic = 0x47444955; ///< "UIDG"
+inline constexpr std::uint32_t snapshot_version = 3;
+
+template <typename T> void write_pod(std::ostream &os, const T &value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    os.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T> void write_pods(std::ostream &os, const T *values, std::size_t count) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    os.write(reinterpret_cast<const char *>(values), static_cast<std::streamsize>(count * sizeof(T)));
+}
+
+template <typename T> T read_pod(std::istream &is) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    T value;
+    if (!is.read(reinterpret_cast<char *>(&value), sizeof(T))) {
+        throw std::runtime_error("Truncated id generator snapshot");
+    }
+    return value;
+}
+
+template <typename T> void read_pods(std::istream &is, T *values, std::size_t count) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    if (!is.read(reinterpret_cast<char *>(values), static_cast<std::streamsize>(count * sizeof(T)))) {
+        throw std::runtime_error("Truncated id generator snapshot");
+    }
+}
+
+/**
+ * @brief layout identifies the id width and policies a snapshot was saved with, see basic_id_generator::save.
+ */
+inline void write_snapshot_header(std::ostream &os, std::uint32_t layout) {
+    write_pod(os, snapshot_magic);
+    write_pod(os, snapshot_version);
+    write_pod(os, layout);
+}
+
+inline void read_snapshot_header(std::istream &is, std::uint32_t expected_layout) {
+    if (read_pod<std::uint32_t>(is) != snapshot_magic) {
+        throw std::runtime_error("Not an id generator snapshot");
+    }
+    std::uint32_t version = read_pod<std::uint32_t>(is);
+    if (version != snapshot_version) {
+        throw std::runtime_error("Unsupported id generator snapshot version " + std::to_string(version));
+    }
+    if (read_pod<std::uint32_t>(is) != expected_layout) {
+        throw std::runtime_error("Id generator snapshot was saved from a different generator type");
+    }
+}
+
+/**
+ * @brief writes ids, in the given order, as (first, length) runs of consecutive ids.
+ */
+template <typename IdT, typename Range> void write_id_runs(std::ostream &os, const Range &ids) {
+    std::vector<IdT> runs; ///< interleaved (first, length) pairs.
+    for (IdT id : ids) {
+        if (!runs.empty() && runs[runs.size() - 2] + runs.back() == id) {
+            ++runs.back();
+        } else {
+            runs.push_back(id);
+            runs.push_back(1);
+        }
+    }
+    write_pod<std::uint64_t>(os, runs.size() / 2);
+    write_pods(os, runs.data(), runs.size());
+}
+
+/**
+ * @brief reads runs written by write_id_runs, calling run_visitor(first, length) on every run in order.
+ * @throws std::runtime_error if an id is not below limit.
+ */
+template <typename IdT, typename RunVisitor> void read_runs(std::istream &is, IdT limit, RunVisitor run_visitor) {
+    constexpr std::uint64_t runs_per_read = 4096; ///< read in blocks, a corrupt run count cannot allocate much.
+    std::uint64_t run_count = read_pod<std::uint64_t>(is);
+    std::vector<IdT> runs; ///< interleaved (first, length) pairs.
+    for (std::uint64_t read = 0; read < run_count; read += runs_per_read) {
+        runs.resize(2 * static_cast<std::size_t>(std::min(runs_per_read, run_count - read)));
+        read_pods(is, runs.data(), runs.size());
+        for (std::size_t i = 0; i < runs.size(); i += 2) {
+            IdT first = runs[i];
+            IdT length = runs[i + 1];
+            if (!in_range(first, limit) || !(length > 0) || length > limit - first) {
+                throw std::runtime_error("Corrupt id generator snapshot");
+            }
+            run_visitor(first, length);
+        }
+    }
+}
+
+/**
+ * @brief reads runs written by write_id_runs, calling visitor on every id in order.
+ * @throws std::runtime_error if an id is not below limit.
+ */
+template <typename IdT, typename Visitor> void read_id_runs(std::istream &is, IdT limit, Visitor visitor) {
+    read_runs(is, limit, [&](IdT first, IdT length) {
+        for (IdT offset = 0; offset < length; ++offset) {
+            visitor(first + offset);
+        }
+    });
+}
+
+/**
+ * @brief writes raw bitset words as a word count followed by the words.
+ */
+inline void write_bit_words(std::ostream &os, std::span<const std::uint64_t> words) {
+    write_pod<std::uint64_t>(os, words.size());
+    write_pods(os, words.data(), words.size());
+}
+
+/**
+ * @brief reads words written by write_bit_words as exactly the words holding limit bits.
+ * @throws std::runtime_error if a bit at or above limit is set.
+ */
+inline std::vector<std::uint64_t> read_bit_words(std::istream &is, std::size_t limit) {
+    constexpr std::uint64_t words_per_read = 4096; ///< words past limit are read in blocks, so do not allocate much.
+    std::uint64_t word_count = read_pod<std::uint64_t>(is);
+    std::size_t limit_words = (limit + 63) / 64;
+    std::vector<std::uint64_t> words(limit_words, 0);
+    std::uint64_t kept_words = std::min<std::uint64_t>(word_count, limit_words);
+    read_pods(is, words.data(), static_cast<std::size_t>(kept_words));
+    std::vector<std::uint64_t> extra_words;
+    for (std::uint64_t read = kept_words; read < word_count; read += words_per_read) {
+        extra_words.resize(static_cast<std::size_t>(std::min(words_per_read, word_count - read)));
+        read_pods(is, extra_words.data(), extra_words.size());
+        if (std::any_of(extra_words.begin(), extra_words.end(), [](std::uint64_t word) { return word != 0; })) {
+            throw std::runtime_error("Corrupt id generator snapshot");
+        }
+    }
+    if (limit % 64 != 0 && (words.back() & ~bit_mask(0, limit % 64)) != 0) {
+        throw std::runtime_error("Corrupt id generator snapshot");
+    }
+    return words;
+}
+
+template <typename IdT> void write_intervals(std::ostream &os, const std::map<IdT, IdT> &intervals) {
+    write_pod<std::uint64_t>(os, intervals.size());
+    for (const auto &[first, length] : intervals) {
+        write_pod(os, first);
+        write_pod(os, length);
+    }
+}
+
+template <typename IdT> void check_range_arguments(IdT n, IdT alignment) {
+    if (!(n > 0) || !(alignment > 0)) {
+        throw std::invalid_argument("Range length and alignment must be greater than 0");
+    }
+}
+
+template <typename IdT> void check_batch_size(std::size_t n, std::span<IdT> out) {
+    if (out.size() < n) {
+        throw std::invalid_argument("Output span holds " + std::to_string(out.size()) + " ids but " +
+                                    std::to_string(n) + " were requested");
+    }
+}
+
+} // namespace id_generator_detail
+
+/**
+ * @brief a reading of a generator's runtime counters, every field is zero when UNIQUE_ID_GENERATOR_NO_COUNTERS is
+ * defined.
+ */
+struct IDGeneratorCounters {
+    std::uint64_t allocations = 0;       ///< ids handed out, ids inside ranges included.
+    std::uint64_t reclaims = 0;          ///< ids given back.
+    std::uint64_t failed_reclaims = 0;   ///< reclaims rejected because the id was not in use.
+    std::uint64_t high_water_mark = 0;   ///< the highest high-water mark reached.
+    std::uint64_t free_list_depth = 0;   ///< reclaimed ids currently waiting to be reused.
+    std::uint64_t exhaustion_events = 0; ///< allocations rejected because too few ids were free.
+
+    std::string to_string() const {
+        return "allocations: " + std::to_string(allocations) + ", reclaims: " + std::to_string(reclaims) +
+               ", failed reclaims: " + std::to_string(failed_reclaims) +
+               ", high-water mark: " + std::to_string(high_water_mark) +
+               ", free list depth: " + std::to_string(free_list_depth) +
+               ", exhaustion events: " + std::to_string(exhaustion_events);
+    }
+};
+
+namespace id_generator_detail {
+
+/**
+ * @brief counters updated with relaxed atomics, so a stats thread can read them at any time without locking.
+ * @details when Shared is false every counter has a single writer and is bumped with a relaxed load and store instead
+ * of a read-modify-write, when it is true they are bumped with fetch_add and kept on their own cache line.
+ */
+template <bool Shared> class alignas(Shared ? cache_line_size : alignof(std::uint64_t)) RelaxedCounters {
+  public:
+    RelaxedCounters() = default;
+    RelaxedCounters(const RelaxedCounters &other) { *this = other; }
+    RelaxedCounters &operator=(const RelaxedCounters &other) {
+        for (std::size_t i = 0; i < counter_count; ++i) {
+            values[i].store(other.values[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        return *this;
+    }
+
+    void add_allocations(std::uint64_t n) { add(allocations, n); }
+    void add_reclaims(std::uint64_t n) { add(reclaims, n); }
+    void add_failed_reclaim() { add(failed_reclaims, 1); }
+    void add_exhaustion_event() { add(exhaustion_events, 1); }
+
+    void raise_high_water_mark(std::uint64_t mark) {
+        std::uint64_t current = values[high_water_mark].load(std::memory_order_relaxed);
+        if constexpr (Shared) {
+            while (mark > current &&
+                   !values[high_water_mark].compare_exchange_weak(current, mark, std::memory_order_relaxed)) {
+            }
+        } else if (mark > current) {
+            values[high_water_mark].store(mark, std::memory_order_relaxed);
+        }
+    }
+
+    void set_free_list_depth(std::uint64_t depth) { values[free_list_depth].store(depth, std::memory_order_relaxed); }
+
+    IDGeneratorCounters read() const {
+        auto load = [&](std::size_t counter) { return values[counter].load(std::memory_order_relaxed); };
+        return {load(allocations),     load(reclaims),        load(failed_reclaims),
+                load(high_water_mark), load(free_list_depth), load(exhaustion_events)};
+    }
+
+  private:
+    enum Counter : std::size_t {
+        allocations,
+        reclaims,
+        failed_reclaims,
+        high_water_mark,
+        free_list_depth,
+        exhaustion_events,
+        counter_count
+    };
+
+    void add(std::size_t counter, std::uint64_t n) {
+        if constexpr (Shared) {
+            values[counter].fetch_add(n, std::memory_order_relaxed);
+        } else {
+            values[counter].store(values[counter].load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+    }
+
+    std::atomic<std::uint64_t> values[counter_count]{};
+};
+
+/**
+ * @brief stands in for RelaxedCounters when UNIQUE_ID_GENERATOR_NO_COUNTERS is defined, every update compiles away.
+ */
+struct NoCounters {
+    void add_allocations(std::uint64_t) {}
+    void add_reclaims(std::uint64_t) {}
+    void add_failed_reclaim() {}
+    void add_exhaustion_event() {}
+    void raise_high_water_mark(std::uint64_t) {}
+    void set_free_list_depth(std::uint64_t) {}
+    IDGeneratorCounters read() const { return {}; }
+};
+
+/**
+ * @brief a small number handed to each thread the first time it asks, threads that ask later get later numbers.
+ */
+inline std::size_t thread_slot() {
+    static std::atomic<std::size_t> next_thread_slot{0};
+    thread_local std::size_t slot = next_thread_slot.fetch_add(1, std::memory_order_relaxed);
+    return slot;
+}
+
+/**
+ * @brief counters bumped by many threads, each thread bumps the stripe picked by its thread slot so threads rarely
+ * share a cache line, and read sums the stripes.
+ */
+template <std::size_t StripeCount> class StripedCounters {
+  public:
+    void add_allocations(std::uint64_t n) { stripe().add_allocations(n); }
+    void add_reclaims(std::uint64_t n) { stripe().add_reclaims(n); }
+    void add_failed_reclaim() { stripe().add_failed_reclaim(); }
+    void add_exhaustion_event() { stripe().add_exhaustion_event(); }
+
+    IDGeneratorCounters read() const {
+        IDGeneratorCounters total;
+        for (const RelaxedCounters<true> &counters : stripes) {
+            IDGeneratorCounters values = counters.read();
+            total.allocations += values.allocations;
+            total.reclaims += values.reclaims;
+            total.failed_reclaims += values.failed_reclaims;
+            total.exhaustion_events += values.exhaustion_events;
+        }
+        return total;
+    }
+
+  private:
+    RelaxedCounters<true> &stripe() { return stripes[thread_slot() % StripeCount]; }
+
+    RelaxedCounters<true> stripes[StripeCount];
+};
+
+#ifdef UNIQUE_ID_GENERATOR_NO_COUNTERS
+inline constexpr bool counters_enabled = false;
+template <bool Shared> using Counters = NoCounters;
+template <std::size_t StripeCount> using ThreadCounters = NoCounters;
+#else
+inline constexpr bool counters_enabled = true;
+template <bool Shared> using Counters = RelaxedCounters<Shared>;
+template <std::size_t StripeCount> using ThreadCounters = StripedCounters<StripeCount>;
+#endif
+
+/**
+ * @brief logs counters as a single line through any logger with an info(std::string) member.
+ */
+template <typename Logger> void log_counters(Logger &logger, const std::string &name, const IDGeneratorCounters &c) {
+    logger.info(name + " counters, " + c.to_string());
+}
+
+} // namespace id_generator_detail
+
+/**
+ * @brief a consistent reading of a generator's occupancy.
+ */
+struct IDGeneratorStats {
+    std::uint64_t used_count = 0;
+    std::uint64_t free_count = 0;
+    std::uint64_t quarantined_count = 0; ///< reclaimed ids waiting out a quarantine, neither used nor free.
+    std::uint64_t high_water_mark = 0;
+    std::uint64_t capacity = 0;
+
+    double get_used_percentage() const {
+        return capacity == 0 ? 0.0 : (static_cast<double>(used_count) / static_cast<double>(capacity)) * 100.0;
+    }
+};
+
+namespace id_generator_detail {
+
+/**
+ * @brief publishes IDGeneratorStats from a single writer through a seqlock, readers on any thread retry while a write
+ * is in progress and never block the writer.
+ * @details the fields are stored with release and loaded with acquire instead of fencing, a reader that sees any field
+ * of a newer write therefore also sees its odd sequence number when it checks the sequence again.
+ */
+class alignas(cache_line_size) SeqlockStats {
+  public:
+    SeqlockStats() = default;
+    SeqlockStats(const SeqlockStats &other) { *this = other; }
+    SeqlockStats &operator=(const SeqlockStats &other) {
+        IDGeneratorStats stats = other.read();
+        publish(stats.used_count, stats.quarantined_count, stats.high_water_mark, stats.capacity);
+        return *this;
+    }
+
+    void publish(std::uint64_t used_count, std::uint64_t quarantined_count, std::uint64_t high_water_mark,
+                 std::uint64_t capacity) {
+        std::uint64_t version = sequence.load(std::memory_order_relaxed);
+        sequence.store(version + 1, std::memory_order_relaxed);
+        published_used_count.store(used_count, std::memory_order_release);
+        published_quarantined_count.store(quarantined_count, std::memory_order_release);
+        published_high_water_mark.store(high_water_mark, std::memory_order_release);
+        published_capacity.store(capacity, std::memory_order_release);
+        sequence.store(version + 2, std::memory_order_release);
+    }
+
+    IDGeneratorStats read() const {
+        while (true) {
+            std::uint64_t version = sequence.load(std::memory_order_acquire);
+            if (version & 1u) {
+                continue;
+            }
+            IDGeneratorStats stats;
+            stats.used_count = published_used_count.load(std::memory_order_acquire);
+            stats.quarantined_count = published_quarantined_count.load(std::memory_order_acquire);
+            stats.high_water_mark = published_high_water_mark.load(std::memory_order_acquire);
+            stats.capacity = published_capacity.load(std::memory_order_acquire);
+            if (sequence.load(std::memory_order_relaxed) == version) {
+                stats.free_count = stats.capacity - stats.used_count - stats.quarantined_count;
+                return stats;
+            }
+        }
+    }
+
+  private:
+    std::atomic<std::uint64_t> sequence{0}; ///< odd while a write is in progress.
+    std::atomic<std::uint64_t> published_used_count{0};
+    std::atomic<std::uint64_t> published_quarantined_count{0};
+    std::atomic<std::uint64_t> published_high_water_mark{0};
+    std::atomic<std::uint64_t> published_capacity{0};
+};
+
+} // namespace id_generator_detail
+
+/**
+ * @brief the int id generator interface kept for legacy callers, the int generators below still implement it but new
+ * code can use basic_id_generator and its aliases directly.
+ */
+class IDGenerator {
+  public:
+    virtual int get_id() = 0;
+    virtual void reclaim_id(int id) = 0;
+
+    /**
+     * @brief writes n ids into out[0, n), either all n are handed out or, if an exception is thrown, none are.
+     * @throws std::invalid_argument if out holds fewer than n elements.
+     */
+    virtual void get_ids(std::size_t n, std::span<int> out) {
+        id_generator_detail::check_batch_size(n, out);
+        std::size_t handed_out = 0;
+        try {
+            for (; handed_out < n; ++handed_out) {
+                out[handed_out] = get_id();
+            }
+        } catch (...) {
+            for (std::size_t i = 0; i < handed_out; ++i) {
+                reclaim_id(out[i]);
+            }
+            throw;
+        }
+    }
+
+    /**
+     * @brief reclaims every id in ids in order, if one of them is rejected the ones before it stay reclaimed.
+     */
+    virtual void reclaim_ids(std::span<const int> ids) {
+        for (int id : ids) {
+            reclaim_id(id);
+        }
+    }
+
+    virtual ~IDGenerator() {}
+};
+
+namespace id_generator_detail {
+
+struct NoInterface {};
+
+/**
+ * @brief int generators keep implementing the legacy IDGenerator interface, other id types have no virtual base.
+ */
+template <typename IdT> using InterfaceFor = std::conditional_t<std::is_same_v<IdT, int>, IDGenerator, NoInterface>;
+
+} // namespace id_generator_detail
+
+/**
+ * @brief a set of disjoint free intervals [first, first + length) that are merged with their neighbours on insert.
+ *
+ * @details the intervals are indexed both by position, for merging and lowest first pops, and by length, for best fit
+ * allocation, so inserting, popping and allocating are logarithmic in the number of intervals.
+ */
+template <typename IdT> class IntervalFreeList {
+  public:
+    /**
+     * @brief adds [first, first + length), which must not overlap any interval already in the list.
+     */
+    void insert(IdT first, IdT length) {
+        IdT last = first + length;
+        auto next = by_first.lower_bound(first);
+        if (next != by_first.end() && next->first == last) {
+            last += next->second;
+            erase_interval(next++);
+        }
+        if (next != by_first.begin()) {
+            auto previous = std::prev(next);
+            if (previous->first + previous->second == first) {
+                first = previous->first;
+                erase_interval(previous);
+            }
+        }
+        insert_interval(first, last - first);
+        total += length;
+    }
+
+    /**
+     * @brief removes length ids starting at a multiple of alignment from the smallest interval able to hold them.
+     * @return the first id of the allocated range, or nothing if no interval fits.
+     * @note with an alignment of 1 the first candidate always fits, larger alignments may skip over smaller intervals.
+     */
+    std::optional<IdT> allocate(IdT length, IdT alignment) {
+        for (auto it = by_length.lower_bound({length, std::numeric_limits<IdT>::lowest()}); it != by_length.end();
+             ++it) {
+            auto [interval_length, interval_first] = *it;
+            IdT aligned_first = id_generator_detail::align_up(interval_first, alignment);
+            if (aligned_first - interval_first > interval_length - length) {
+                continue;
+            }
+            erase_interval(by_first.find(interval_first));
+            if (aligned_first != interval_first) {
+                insert_interval(interval_first, aligned_first - interval_first);
+            }
+            IdT interval_last = interval_first + interval_length;
+            if (aligned_first + length != interval_last) {
+                insert_interval(aligned_first + length, interval_last - (aligned_first + length));
+            }
+            total -= length;
+            return aligned_first;
+        }
+        return std::nullopt;
+    }
+
+    /**
+     * @brief removes and returns the lowest id in the list, which must not be empty.
+     */
+    IdT pop() {
+        auto lowest = by_first.begin();
+        auto [first, length] = *lowest;
+        erase_interval(lowest);
+        if (length > 1) {
+            insert_interval(first + 1, length - 1);
+        }
+        --total;
+        return first;
+    }
+
+    /**
+     * @brief removes the highest interval if it ends exactly at end and returns its first id, otherwise returns end.
+     */
+    IdT trim_back(IdT end) {
+        if (by_first.empty()) {
+            return end;
+        }
+        auto highest = std::prev(by_first.end());
+        auto [first, length] = *highest;
+        if (first + length != end) {
+            return end;
+        }
+        erase_interval(highest);
+        total -= length;
+        return first;
+    }
+
+    /**
+     * @brief removes every id at or above end, the intervals above it in a single step each.
+     */
+    void erase_from(IdT end) {
+        while (!by_first.empty()) {
+            auto highest = std::prev(by_first.end());
+            auto [first, length] = *highest;
+            if (!(end < first + length)) {
+                return;
+            }
+            erase_interval(highest);
+            if (first < end) {
+                insert_interval(first, end - first);
+                total -= first + length - end;
+                return;
+            }
+            total -= length;
+        }
+    }
+
+    /**
+     * @brief removes a single id, which must be in the list, splitting the interval holding it.
+     */
+    void erase(IdT id) {
+        auto interval = std::prev(by_first.upper_bound(id));
+        auto [first, length] = *interval;
+        erase_interval(interval);
+        if (id != first) {
+            insert_interval(first, id - first);
+        }
+        if (id - first + 1 != length) {
+            insert_interval(id + 1, length - (id - first) - 1);
+        }
+        --total;
+    }
+
+    bool contains(IdT id) const {
+        auto next = by_first.upper_bound(id);
+        if (next == by_first.begin()) {
+            return false;
+        }
+        auto previous = std::prev(next);
+        return id - previous->first < previous->second;
+    }
+
+    bool empty() const { return by_first.empty(); }
+    IdT front() const { return by_first.begin()->first; } ///< the lowest id, the list must not be empty.
+    IdT count() const { return total; }
+    std::size_t interval_count() const { return by_first.size(); }
+    const std::map<IdT, IdT> &intervals() const { return by_first; }
+
+  private:
+    void insert_interval(IdT first, IdT length) {
+        by_first.emplace(first, length);
+        by_length.emplace(length, first);
+    }
+
+    void erase_interval(typename std::map<IdT, IdT>::iterator it) {
+        by_length.erase({it->second, it->first});
+        by_first.erase(it);
+    }
+
+    std::map<IdT, IdT> by_first;              ///< first id to length.
+    std::set<std::pair<IdT, IdT>> by_length; ///< (length, first id), ordered for best fit.
+    IdT total = 0;
+};
+
+/**
+ * @brief a bitset with 64-ary summary levels stacked above its words up to a single word, so the lowest set bit at or
+ * after any index is found with one count-trailing-zero per level, O(log64 n), instead of a linear scan.
+ *
+ * @note a summary bit is set exactly when the corresponding word of the level below is non-zero.
+ * @note the levels are allocated together with calloc, so constructing even a very large bitset is constant time, the
+ * operating system only hands out (zeroed) pages once they are touched.
+ */
+class HierarchicalBitset {
+  public:
+    static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+    explicit HierarchicalBitset(std::size_t size) : bit_count(size) {
+        std::size_t total_words = 0;
+        for (std::size_t bits = size;; bits = levels.back().word_count) {
+            levels.push_back(Level{total_words, (bits + 63) / 64});
+            total_words += levels.back().word_count;
+            if (levels.back().word_count <= 1) {
+                break;
+            }
+        }
+        buffer = id_generator_detail::allocate_zeroed<std::uint64_t>(total_words);
+    }
+
+    HierarchicalBitset(const HierarchicalBitset &other)
+        : bit_count(other.bit_count), set_count(other.set_count), levels(other.levels),
+          buffer(id_generator_detail::allocate_zeroed<std::uint64_t>(other.total_words())) {
+        std::memcpy(buffer.get(), other.buffer.get(), total_words() * sizeof(std::uint64_t));
+    }
+
+    HierarchicalBitset &operator=(const HierarchicalBitset &other) {
+        if (this != &other) {
+            *this = HierarchicalBitset(other);
+        }
+        return *this;
+    }
+
+    HierarchicalBitset(HierarchicalBitset &&) noexcept = default;
+    HierarchicalBitset &operator=(HierarchicalBitset &&) noexcept = default;
+
+    std::size_t size() const { return bit_count; }
+
+    /**
+     * @brief grows the bitset to new_size bits, the new bits are clear, shrinking is a no-op.
+     */
+    void resize(std::size_t new_size) {
+        if (new_size <= bit_count) {
+            return;
+        }
+        HierarchicalBitset grown(new_size);
+        std::memcpy(grown.level_words(0), level_words(0), levels[0].word_count * sizeof(std::uint64_t));
+        grown.set_count = set_count;
+        grown.rebuild_summaries();
+        *this = std::move(grown);
+    }
+    std::size_t count() const { return set_count; }
+    bool any() const { return set_count != 0; }
+
+    bool test(std::size_t index) const { return (level_words(0)[index / 64] >> (index % 64)) & 1u; }
+
+    void set(std::size_t index) {
+        std::uint64_t *words = level_words(0);
+        std::uint64_t mask = std::uint64_t(1) << (index % 64);
+        if (words[index / 64] & mask) {
+            return;
+        }
+        ++set_count;
+        // a word that was zero gets its bit in the level above, which may itself have been zero.
+        for (std::size_t level = 0; level < levels.size(); ++level, index /= 64) {
+            std::uint64_t &word = level_words(level)[index / 64];
+            bool was_zero = word == 0;
+            word |= std::uint64_t(1) << (index % 64);
+            if (!was_zero) {
+                break;
+            }
+        }
+    }
+
+    void reset(std::size_t index) {
+        std::uint64_t *words = level_words(0);
+        std::uint64_t mask = std::uint64_t(1) << (index % 64);
+        if (!(words[index / 64] & mask)) {
+            return;
+        }
+        --set_count;
+        // a word that became zero loses its bit in the level above, which may become zero in turn.
+        for (std::size_t level = 0; level < levels.size(); ++level, index /= 64) {
+            std::uint64_t &word = level_words(level)[index / 64];
+            word &= ~(std::uint64_t(1) << (index % 64));
+            if (word != 0) {
+                break;
+            }
+        }
+    }
+
+    /**
+     * @brief returns the lowest set index, or npos if no bit is set.
+     */
+    std::size_t find_first() const { return find_next(0); }
+
+    /**
+     * @brief returns the lowest set index that is greater than or equal to from, or npos if there is none.
+     * @details climbs while the rest of the current word is empty, continuing from the next word one level up, then
+     * descends through the lowest set bit of every level below.
+     */
+    std::size_t find_next(std::size_t from) const {
+        if (from >= bit_count) {
+            return npos;
+        }
+        std::size_t index = from;
+        std::size_t level = 0;
+        while (true) {
+            std::size_t word_index = index / 64;
+            if (word_index >= levels[level].word_count) {
+                return npos;
+            }
+            std::uint64_t word = level_words(level)[word_index] & (~std::uint64_t(0) << (index % 64));
+            if (word != 0) {
+                index = word_index * 64 + std::countr_zero(word);
+                break;
+            }
+            if (++level == levels.size()) {
+                return npos;
+            }
+            index = word_index + 1;
+        }
+        while (level > 0) {
+            --level;
+            index = index * 64 + std::countr_zero(level_words(level)[index]);
+        }
+        return index;
+    }
+
+    std::span<const std::uint64_t> raw_words() const { return {level_words(0), levels[0].word_count}; }
+
+    /**
+     * @brief replaces the bits with source, missing trailing words are cleared.
+     * @throws std::invalid_argument if source has more words than the bitset or sets bits at or above size().
+     */
+    void assign_raw_words(std::span<const std::uint64_t> source) {
+        std::size_t word_count = levels[0].word_count;
+        if (source.size() > word_count ||
+            (!source.empty() && source.size() * 64 > bit_count && source.back() >> (bit_count % 64) != 0)) {
+            throw std::invalid_argument("Raw words do not fit in the bitset");
+        }
+        std::memset(buffer.get(), 0, total_words() * sizeof(std::uint64_t));
+        if (!source.empty()) {
+            std::memcpy(level_words(0), source.data(), source.size() * sizeof(std::uint64_t));
+        }
+        set_count = 0;
+        for (std::uint64_t word : source) {
+            set_count += static_cast<std::size_t>(std::popcount(word));
+        }
+        rebuild_summaries();
+    }
+
+  private:
+    struct Level {
+        std::size_t offset;     ///< of the level's first word in the buffer.
+        std::size_t word_count;
+    };
+
+    std::uint64_t *level_words(std::size_t level) { return buffer.get() + levels[level].offset; }
+    const std::uint64_t *level_words(std::size_t level) const { return buffer.get() + levels[level].offset; }
+    std::size_t total_words() const { return levels.back().offset + levels.back().word_count; }
+
+    /**
+     * @brief recomputes every summary level from the words, which is linear in the words.
+     */
+    void rebuild_summaries() {
+        for (std::size_t level = 1; level < levels.size(); ++level) {
+            std::uint64_t *summary = level_words(level);
+            const std::uint64_t *below = level_words(level - 1);
+            std::memset(summary, 0, levels[level].word_count * sizeof(std::uint64_t));
+            for (std::size_t word_index = 0; word_index < levels[level - 1].word_count; ++word_index) {
+                if (below[word_index] != 0) {
+                    summary[word_index / 64] |= std::uint64_t(1) << (word_index % 64);
+                }
+            }
+        }
+    }
+
+    std::size_t bit_count;
+    std::size_t set_count = 0;
+    std::vector<Level> levels; ///< the words first, then every summary level up to one word.
+    id_generator_detail::ZeroedArray<std::uint64_t> buffer;
+};
+
+/**
+ * @brief reuse policy handing reclaimed ids back in the order they were reclaimed.
+ */
+template <typename IdT> class fifo_reuse {
+  public:
+    using id_type = IdT;
+    static constexpr std::uint32_t snapshot_tag = 1;
+    static constexpr bool compacts = false;
+
+    void push(IdT id) { ids.push_back(id); }
+    IdT pop() {
+        IdT id = ids.front();
+        ids.pop_front();
+        return id;
+    }
+    bool empty() const { return ids.empty(); }
+    std::size_t size() const { return ids.size(); }
+
+    /**
+     * @brief visits the ids in the order pop hands them out.
+     */
+    template <typename Visitor> void for_each(Visitor visitor) const {
+        for (IdT id : ids) {
+            visitor(id);
+        }
+    }
+
+    /**
+     * @brief writes the queue in order as runs of consecutive ids.
+     */
+    void save(std::ostream &os) const { id_generator_detail::write_id_runs<IdT>(os, ids); }
+
+    /**
+     * @throws std::runtime_error if an id is not below limit.
+     */
+    void load(std::istream &is, IdT limit) {
+        std::deque<IdT> loaded;
+        id_generator_detail::read_id_runs(is, limit, [&](IdT id) { loaded.push_back(id); });
+        ids = std::move(loaded);
+    }
+
+  private:
+    std::deque<IdT> ids;
+};
+
+/**
+ * @brief reuse policy handing back the most recently reclaimed id first, kept in a contiguous stack.
+ * @note whatever is indexed by the reused id was touched when it was reclaimed, so it is likely still in cache.
+ */
+template <typename IdT> class lifo_reuse {
+  public:
+    using id_type = IdT;
+    static constexpr std::uint32_t snapshot_tag = 3;
+    static constexpr bool compacts = false;
+
+    void push(IdT id) { ids.push_back(id); }
+    IdT pop() {
+        IdT id = ids.back();
+        ids.pop_back();
+        return id;
+    }
+    bool empty() const { return ids.empty(); }
+    std::size_t size() const { return ids.size(); }
+
+    /**
+     * @brief visits the ids in the order pop hands them out, which is the reverse of the order they were pushed.
+     */
+    template <typename Visitor> void for_each(Visitor visitor) const {
+        for (auto it = ids.rbegin(); it != ids.rend(); ++it) {
+            visitor(*it);
+        }
+    }
+
+    /**
+     * @brief writes the stack bottom to top as runs of consecutive ids.
+     */
+    void save(std::ostream &os) const { id_generator_detail::write_id_runs<IdT>(os, ids); }
+
+    /**
+     * @throws std::runtime_error if an id is not below limit.
+     */
+    void load(std::istream &is, IdT limit) {
+        std::vector<IdT> loaded;
+        id_generator_detail::read_id_runs(is, limit, [&](IdT id) { loaded.push_back(id); });
+        ids = std::move(loaded);
+    }
+
+  private:
+    std::vector<IdT> ids; ///< the top of the stack is the back.
+};
+
+/**
+ * @brief reuse policy always handing back the smallest reclaimed id, stored one bit per id in a HierarchicalBitset
+ * that grows with the largest id reclaimed.
+ * @note it compacts, whenever the ids just below the generator's high-water mark are all free the mark shrinks back
+ * down, so the live ids stay packed at the bottom of the id space.
+ */
+template <typename IdT> class lowest_free_reuse {
+  public:
+    using id_type = IdT;
+    static constexpr std::uint32_t snapshot_tag = 2;
+    static constexpr bool compacts = true;
+
+    void push(IdT id) {
+        std::size_t index = static_cast<std::size_t>(id);
+        if (index >= bits.size()) {
+            bits.resize(std::max(index + 1, bits.size() * 2));
+        }
+        bits.set(index);
+    }
+    IdT pop() {
+        std::size_t index = bits.find_first();
+        bits.reset(index);
+        return static_cast<IdT>(index);
+    }
+    IdT front() const { return static_cast<IdT>(bits.find_first()); }
+    bool empty() const { return !bits.any(); }
+    std::size_t size() const { return bits.count(); }
+    bool contains(IdT id) const {
+        std::size_t index = static_cast<std::size_t>(id);
+        return index < bits.size() && bits.test(index);
+    }
+    void erase(IdT id) { bits.reset(static_cast<std::size_t>(id)); }
+
+    /**
+     * @brief visits the ids in the order pop hands them out, which is ascending.
+     */
+    template <typename Visitor> void for_each(Visitor visitor) const {
+        for (std::size_t index = bits.find_first(); index != HierarchicalBitset::npos;
+             index = bits.find_next(index + 1)) {
+            visitor(static_cast<IdT>(index));
+        }
+    }
+
+    /**
+     * @brief writes the raw bitset words.
+     */
+    void save(std::ostream &os) const { id_generator_detail::write_bit_words(os, bits.raw_words()); }
+
+    /**
+     * @throws std::runtime_error if an id is not below limit.
+     */
+    void load(std::istream &is, IdT limit) {
+        std::size_t bit_limit = static_cast<std::size_t>(limit);
+        std::vector<std::uint64_t> words = id_generator_detail::read_bit_words(is, bit_limit);
+        HierarchicalBitset loaded(bit_limit);
+        loaded.assign_raw_words(words);
+        bits = std::move(loaded);
+    }
+
+  private:
+    HierarchicalBitset bits{0};
+};
+
+/**
+ * @brief reuse policy keeping no ids of its own, the generator hands out the lowest id below its high-water mark that
+ * the storage does not hold, which the storage finds through its own summary levels.
+ * @details on bitmap_storage this takes about one bit per id plus 1/64 for the summary, where lowest_free_reuse adds
+ * a second bit per id. it compacts, the generator still keeps freed ranges as intervals so allocate_range reuses them
+ * best fit without scanning the storage. snapshots use lowest_free_reuse's encoding, so either policy loads the
+ * other's.
+ * @note the storage must provide used_end, and the policy cannot be quarantined since every unused id is free.
+ */
+template <typename IdT> class lowest_unused_reuse {
+  public:
+    using id_type = IdT;
+    static constexpr std::uint32_t snapshot_tag = lowest_free_reuse<IdT>::snapshot_tag;
+    static constexpr bool compacts = true;
+    static constexpr bool derived_from_storage = true;
+};
+
+/**
+ * @brief reuse policy always handing back the smallest reclaimed id, stored as merged intervals so memory grows with
+ * the number of free runs rather than the number of free ids, with logarithmic operations over any IdT.
+ * @note it compacts like lowest_free_reuse, but a free run ending at the generator's high-water mark is trimmed off in
+ * a single step. it also takes the generator's free ranges, so reclaimed ids and freed ranges merge into one set that
+ * allocate_range searches.
+ */
+template <typename IdT> class interval_reuse {
+  public:
+    using id_type = IdT;
+    static constexpr std::uint32_t snapshot_tag = 4;
+    static constexpr bool compacts = true;
+
+    void push(IdT id) { free_ids.insert(id, IdT(1)); }
+    void push_range(IdT first, IdT n) { free_ids.insert(first, n); }
+    std::optional<IdT> allocate(IdT n, IdT alignment) { return free_ids.allocate(n, alignment); }
+    IdT pop() { return free_ids.pop(); }
+    IdT front() const { return free_ids.front(); }
+    bool empty() const { return free_ids.empty(); }
+    std::size_t size() const { return static_cast<std::size_t>(free_ids.count()); }
+    bool contains(IdT id) const { return free_ids.contains(id); }
+    void erase(IdT id) { free_ids.erase(id); }
+    IdT trim_back(IdT end) { return free_ids.trim_back(end); }
+
+    /**
+     * @brief visits the ids in the order pop hands them out, which is ascending.
+     */
+    template <typename Visitor> void for_each(Visitor visitor) const {
+        for (const auto &[first, length] : free_ids.intervals()) {
+            for (IdT offset = 0; offset < length; ++offset) {
+                visitor(first + offset);
+            }
+        }
+    }
+
+    /**
+     * @brief writes the intervals in ascending order.
+     */
+    void save(std::ostream &os) const { id_generator_detail::write_intervals(os, free_ids.intervals()); }
+
+    /**
+     * @throws std::runtime_error if an interval is not below limit or overlaps the one before it.
+     */
+    void load(std::istream &is, IdT limit) {
+        IntervalFreeList<IdT> loaded;
+        std::uint64_t interval_count = id_generator_detail::read_pod<std::uint64_t>(is);
+        IdT previous_end = 0;
+        for (std::uint64_t i = 0; i < interval_count; ++i) {
+            IdT first = id_generator_detail::read_pod<IdT>(is);
+            IdT length = id_generator_detail::read_pod<IdT>(is);
+            if (!id_generator_detail::in_range(first, limit) || !(length > 0) || length > limit - first ||
+                first < previous_end) {
+                throw std::runtime_error("Corrupt id generator snapshot");
+            }
+            loaded.insert(first, length);
+            previous_end = first + length;
+        }
+        free_ids = std::move(loaded);
+    }
+
+  private:
+    IntervalFreeList<IdT> free_ids;
+};
+
+/**
+ * @brief reuse policy wrapping another one and holding reclaimed ids in quarantine for delay_epochs calls to
+ * advance_epoch before Inner may hand them out again, so late references to a reclaimed id cannot hit a new owner.
+ *
+ * @details quarantined ids are kept in a ring of delay_epochs batches, advance_epoch moves the oldest batch into the
+ * inner policy as a whole. ids freed as a range are held as a single run and handed back to the caller's free ranges
+ * when released. a quarantined id is neither used nor free, the generator sorts the batches into runs only when it
+ * walks its free ids, so quarantining and releasing an id stay constant time.
+ */
+template <typename Inner> class quarantined_reuse {
+  public:
+    using id_type = typename Inner::id_type;
+    static constexpr std::uint32_t snapshot_tag = 0x10 | Inner::snapshot_tag;
+    static constexpr bool compacts = Inner::compacts;
+
+    explicit quarantined_reuse(std::size_t delay_epochs = 1, Inner inner = Inner())
+        : inner(std::move(inner)), batches(delay_epochs) {}
+
+    void push(id_type id) {
+        if (batches.empty()) {
+            inner.push(id);
+        } else {
+            batches[current_batch].ids.push_back(id);
+            ++quarantined;
+        }
+    }
+
+    /**
+     * @brief quarantines the n ids starting at first as one run, release_range(first, n) is called once they are
+     * released, right away without a delay.
+     */
+    template <typename ReleaseRange> void quarantine_range(id_type first, id_type n, ReleaseRange release_range) {
+        if (batches.empty()) {
+            release_range(first, n);
+        } else {
+            batches[current_batch].ranges.push_back(first);
+            batches[current_batch].ranges.push_back(n);
+            quarantined += static_cast<std::size_t>(n);
+        }
+    }
+
+    /**
+     * @brief releases the ids reclaimed delay_epochs epochs ago, single ids to the inner policy and ranges to
+     * release_range(first, n).
+     */
+    template <typename ReleaseRange> void advance_epoch(ReleaseRange release_range) {
+        if (batches.empty()) {
+            return;
+        }
+        current_batch = (current_batch + 1) % batches.size();
+        Batch &oldest = batches[current_batch];
+        for (id_type id : oldest.ids) {
+            inner.push(id);
+        }
+        quarantined -= oldest.ids.size();
+        for (std::size_t i = 0; i < oldest.ranges.size(); i += 2) {
+            quarantined -= static_cast<std::size_t>(oldest.ranges[i + 1]);
+            release_range(oldest.ranges[i], oldest.ranges[i + 1]);
+        }
+        oldest.ids.clear();
+        oldest.ranges.clear();
+    }
+
+    id_type pop() { return inner.pop(); }
+    bool empty() const { return inner.empty(); }
+    std::size_t size() const { return inner.size(); }
+    std::size_t quarantined_count() const { return quarantined; }
+    std::size_t get_delay_epochs() const { return batches.size(); }
+
+    /**
+     * @brief the quarantined ids as maximal runs in ascending order, interleaved (first, length) pairs, sorted out of
+     * the batches in O(q log q) for q quarantined ids and ranges.
+     */
+    std::vector<id_type> quarantined_runs() const {
+        std::vector<id_type> runs;
+        for (auto [first, length] : sorted_entries(batches)) {
+            if (!runs.empty() && runs[runs.size() - 2] + runs.back() == first) {
+                runs.back() += length;
+            } else {
+                runs.push_back(first);
+                runs.push_back(length);
+            }
+        }
+        return runs;
+    }
+
+    /**
+     * @brief hands free ranges straight to an inner policy that keeps them, they are not quarantined.
+     */
+    void push_range(id_type first, id_type n)
+        requires requires(Inner &policy) { policy.push_range(first, n); }
+    {
+        inner.push_range(first, n);
+    }
+    std::optional<id_type> allocate(id_type n, id_type alignment)
+        requires requires(Inner &policy) { policy.allocate(n, alignment); }
+    {
+        return inner.allocate(n, alignment);
+    }
+    id_type trim_back(id_type end)
+        requires requires(Inner &policy) { policy.trim_back(end); }
+    {
+        return inner.trim_back(end);
+    }
+
+    id_type front() const
+        requires(compacts)
+    {
+        return inner.front();
+    }
+    bool contains(id_type id) const
+        requires(compacts)
+    {
+        return inner.contains(id);
+    }
+    void erase(id_type id)
+        requires(compacts)
+    {
+        inner.erase(id);
+    }
+
+    /**
+     * @brief visits the free ids in the order pop hands them out, quarantined ids are not visited.
+     */
+    template <typename Visitor> void for_each(Visitor visitor) const { inner.for_each(visitor); }
+
+    /**
+     * @brief visits the quarantined ids, oldest batch first.
+     */
+    template <typename Visitor> void for_each_quarantined(Visitor visitor) const {
+        for (std::size_t i = 1; i <= batches.size(); ++i) {
+            const Batch &batch = batches[(current_batch + i) % batches.size()];
+            for (id_type id : batch.ids) {
+                visitor(id);
+            }
+            for (std::size_t run = 0; run < batch.ranges.size(); run += 2) {
+                for (id_type offset = 0; offset < batch.ranges[run + 1]; ++offset) {
+                    visitor(batch.ranges[run] + offset);
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief writes the inner policy followed by the delay and every batch, oldest first, as its single ids and then
+     * its ranges.
+     */
+    void save(std::ostream &os) const {
+        inner.save(os);
+        id_generator_detail::write_pod<std::uint64_t>(os, batches.size());
+        for (std::size_t i = 1; i <= batches.size(); ++i) {
+            const Batch &batch = batches[(current_batch + i) % batches.size()];
+            id_generator_detail::write_id_runs<id_type>(os, batch.ids);
+            id_generator_detail::write_pod<std::uint64_t>(os, batch.ranges.size() / 2);
+            id_generator_detail::write_pods(os, batch.ranges.data(), batch.ranges.size());
+        }
+    }
+
+    /**
+     * @throws std::runtime_error if an id is not below limit.
+     */
+    void load(std::istream &is, id_type limit) {
+        Inner loaded_inner;
+        loaded_inner.load(is, limit);
+        std::uint64_t delay_epochs = id_generator_detail::read_pod<std::uint64_t>(is);
+        if (delay_epochs > std::numeric_limits<std::uint32_t>::max()) {
+            throw std::runtime_error("Corrupt id generator snapshot");
+        }
+        // grown one batch per read so a corrupt count runs into the end of the stream before allocating much.
+        std::vector<Batch> loaded_batches;
+        std::size_t loaded_quarantined = 0;
+        for (std::uint64_t i = 0; i < delay_epochs; ++i) {
+            Batch &batch = loaded_batches.emplace_back();
+            id_generator_detail::read_id_runs(is, limit, [&](id_type id) { batch.ids.push_back(id); });
+            loaded_quarantined += batch.ids.size();
+            id_generator_detail::read_runs(is, limit, [&](id_type first, id_type length) {
+                batch.ranges.push_back(first);
+                batch.ranges.push_back(length);
+                loaded_quarantined += static_cast<std::size_t>(length);
+            });
+        }
+        // an id quarantined twice would be handed out twice once released.
+        id_type end{};
+        for (auto [first, length] : sorted_entries(loaded_batches)) {
+            if (first < end) {
+                throw std::runtime_error("Corrupt id generator snapshot");
+            }
+            end = first + length;
+        }
+        inner = std::move(loaded_inner);
+        batches = std::move(loaded_batches);
+        current_batch = batches.empty() ? 0 : batches.size() - 1;
+        quarantined = loaded_quarantined;
+    }
+
+  private:
+    struct Batch {
+        std::vector<id_type> ids;
+        std::vector<id_type> ranges; ///< interleaved (first, length) pairs of the ranges freed together.
+    };
+
+    /**
+     * @return every quarantined id and range of the batches as (first, length) pairs in ascending order.
+     */
+    static std::vector<std::pair<id_type, id_type>> sorted_entries(const std::vector<Batch> &batches) {
+        std::vector<std::pair<id_type, id_type>> entries;
+        for (const Batch &batch : batches) {
+            for (id_type id : batch.ids) {
+                entries.emplace_back(id, id_type(1));
+            }
+            for (std::size_t i = 0; i < batch.ranges.size(); i += 2) {
+                entries.emplace_back(batch.ranges[i], batch.ranges[i + 1]);
+            }
+        }
+        std::sort(entries.begin(), entries.end());
+        return entries;
+    }
+
+    Inner inner;
+    std::vector<Batch> batches; ///< batches[current_batch] collects the ids reclaimed this epoch.
+    std::size_t current_batch = 0;
+    std::size_t quarantined = 0; ///< ids held in every batch, ranges counted by their length.
+};
+
+/**
+ * @brief storage keeping the used ids in a hash set, ids are unbounded up to the largest IdT.
+ *
+ * @details costs tens of bytes per id, roaring_storage is the default and is smaller for all but very sparse ids.
+ */
+template <typename IdT> class hash_set_storage {
+  public:
+    static constexpr bool bounded = false;
+    static constexpr bool concurrent_contains = false;
+    static constexpr std::uint32_t snapshot_tag = 1;
+
+    IdT capacity() const { return std::numeric_limits<IdT>::max(); }
+    bool contains(IdT id) const { return ids.find(id) != ids.end(); }
+    void insert(IdT id) { ids.insert(id); }
+    void erase(IdT id) { ids.erase(id); }
+    void insert_range(IdT first, IdT n) {
+        for (IdT offset = 0; offset < n; ++offset) {
+            ids.insert(first + offset);
+        }
+    }
+    void erase_range(IdT first, IdT n) {
+        for (IdT offset = 0; offset < n; ++offset) {
+            ids.erase(first + offset);
+        }
+    }
+    std::size_t size() const { return ids.size(); }
+    void reserve(std::size_t count) { ids.reserve(count); }
+
+    /**
+     * @brief visits the used ids in no particular order.
+     */
+    template <typename Visitor> void for_each(Visitor visitor) const {
+        for (IdT id : ids) {
+            visitor(id);
+        }
+    }
+
+    /**
+     * @brief the lowest used id in [from, end), or end if there is none, found by probing every id in turn.
+     */
+    IdT next_used(IdT from, IdT end) const {
+        if (ids.empty()) {
+            return end;
+        }
+        for (; from < end; ++from) {
+            if (contains(from)) {
+                return from;
+            }
+        }
+        return end;
+    }
+
+    /**
+     * @brief the lowest unused id in [from, end), or end if there is none.
+     */
+    IdT next_unused(IdT from, IdT end) const {
+        for (; from < end; ++from) {
+            if (!contains(from)) {
+                return from;
+            }
+        }
+        return end;
+    }
+
+  private:
+    std::unordered_set<IdT> ids;
+};
+
+namespace id_generator_detail {
+
+inline constexpr std::uint32_t roaring_chunk_size = 1u << 16; ///< ids per chunk, a chunk is keyed by the high bits.
+inline constexpr std::uint32_t roaring_none = roaring_chunk_size; ///< returned by next_set and next_clear.
+
+/**
+ * @brief the low 16 bits of a chunk's ids as a sorted array, for chunks holding at most 4096 ids.
+ */
+class roaring_array {
+  public:
+    static constexpr std::size_t max_size = 4096;
+
+    bool contains(std::uint16_t low) const { return std::binary_search(values.begin(), values.end(), low); }
+    void insert(std::uint16_t low) { values.insert(std::lower_bound(values.begin(), values.end(), low), low); }
+    void erase(std::uint16_t low) { values.erase(std::lower_bound(values.begin(), values.end(), low)); }
+    void append(std::uint16_t low) { values.push_back(low); }
+
+    /**
+     * @brief inserts [first, last], none of which may be present yet.
+     */
+    void insert_range(std::uint32_t first, std::uint32_t last) {
+        auto position = values.insert(std::lower_bound(values.begin(), values.end(), first), last - first + 1, 0);
+        std::iota(position, position + (last - first + 1), static_cast<std::uint16_t>(first));
+    }
+
+    /**
+     * @brief erases [first, last], all of which must be present.
+     */
+    void erase_range(std::uint32_t first, std::uint32_t last) {
+        auto begin = std::lower_bound(values.begin(), values.end(), first);
+        values.erase(begin, begin + (last - first + 1));
+    }
+
+    std::size_t size() const { return values.size(); }
+    std::size_t bytes() const { return values.size() * sizeof(std::uint16_t); }
+
+    std::size_t run_count() const {
+        std::size_t runs = 0;
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            runs += i == 0 || values[i] != values[i - 1] + 1;
+        }
+        return runs;
+    }
+
+    std::uint32_t next_set(std::uint32_t from) const {
+        auto it = std::lower_bound(values.begin(), values.end(), from);
+        return it == values.end() ? roaring_none : *it;
+    }
+
+    std::uint32_t next_clear(std::uint32_t from) const {
+        for (auto it = std::lower_bound(values.begin(), values.end(), from); it != values.end() && *it == from; ++it) {
+            ++from;
+        }
+        return from;
+    }
+
+    template <typename Visitor> void for_each(Visitor visitor) const {
+        for (std::uint16_t low : values) {
+            visitor(low);
+        }
+    }
+
+  private:
+    std::vector<std::uint16_t> values;
+};
+
+/**
+ * @brief one bit per id of a chunk, for dense chunks whose ids are not in long runs.
+ */
+class roaring_bitmap {
+  public:
+    static constexpr std::size_t word_count = roaring_chunk_size / 64;
+
+    roaring_bitmap() = default;
+
+    /**
+     * @brief takes the low 16 bits of the ids from source, bit i of word w standing for w * 64 + i, missing trailing
+     * words are clear.
+     */
+    explicit roaring_bitmap(std::span<const std::uint64_t> source) {
+        std::copy_n(source.begin(), std::min(source.size(), word_count), words.begin());
+        for (std::uint64_t word : words) {
+            count += static_cast<std::size_t>(std::popcount(word));
+        }
+    }
+
+    bool contains(std::uint16_t low) const { return (words[low / 64] >> (low % 64)) & 1u; }
+    void insert(std::uint16_t low) {
+        words[low / 64] |= std::uint64_t(1) << (low % 64);
+        ++count;
+    }
+    void erase(std::uint16_t low) {
+        words[low / 64] &= ~(std::uint64_t(1) << (low % 64));
+        --count;
+    }
+    void append(std::uint16_t low) { insert(low); }
+
+    /**
+     * @brief inserts [first, last] a word at a time, none of which may be present yet.
+     */
+    void insert_range(std::uint32_t first, std::uint32_t last) {
+        id_generator_detail::fill_bits(words.data(), first, last + 1, true);
+        count += last - first + 1;
+    }
+
+    /**
+     * @brief erases [first, last] a word at a time, all of which must be present.
+     */
+    void erase_range(std::uint32_t first, std::uint32_t last) {
+        id_generator_detail::fill_bits(words.data(), first, last + 1, false);
+        count -= last - first + 1;
+    }
+
+    std::size_t size() const { return count; }
+    std::size_t bytes() const { return word_count * sizeof(std::uint64_t); }
+
+    std::size_t run_count() const {
+        std::size_t runs = 0;
+        std::uint64_t carry = 0;
+        for (std::uint64_t word : words) {
+            runs += std::popcount(word & ~((word << 1) | carry));
+            carry = word >> 63;
+        }
+        return runs;
+    }
+
+    std::uint32_t next_set(std::uint32_t from) const { return find_next(from, 0); }
+    std::uint32_t next_clear(std::uint32_t from) const { return find_next(from, ~std::uint64_t(0)); }
+
+    template <typename Visitor> void for_each(Visitor visitor) const {
+        for (std::size_t word_index = 0; word_index < word_count; ++word_index) {
+            for (std::uint64_t word = words[word_index]; word != 0; word &= word - 1) {
+                visitor(static_cast<std::uint16_t>(word_index * 64 + std::countr_zero(word)));
+            }
+        }
+    }
+
+  private:
+    std::uint32_t find_next(std::uint32_t from, std::uint64_t flip) const {
+        std::size_t word_index = from / 64;
+        std::uint64_t word = (words[word_index] ^ flip) & (~std::uint64_t(0) << (from % 64));
+        while (word == 0) {
+            if (++word_index == word_count) {
+                return roaring_none;
+            }
+            word = words[word_index] ^ flip;
+        }
+        return static_cast<std::uint32_t>(word_index * 64 + std::countr_zero(word));
+    }
+
+    std::vector<std::uint64_t> words = std::vector<std::uint64_t>(word_count);
+    std::size_t count = 0;
+};
+
+/**
+ * @brief a chunk's ids as sorted, disjoint inclusive runs, for chunks whose ids are clustered.
+ */
+class roaring_runs {
+  public:
+    bool contains(std::uint16_t low) const {
+        auto it = run_after(low);
+        return it != runs.begin() && std::prev(it)->last >= low;
+    }
+
+    void insert(std::uint16_t low) {
+        auto next = run_after(low);
+        bool joins_previous = next != runs.begin() && std::prev(next)->last + 1 == low;
+        bool joins_next = next != runs.end() && low + 1 == next->first;
+        if (joins_previous && joins_next) {
+            std::prev(next)->last = next->last;
+            runs.erase(next);
+        } else if (joins_previous) {
+            std::prev(next)->last = low;
+        } else if (joins_next) {
+            next->first = low;
+        } else {
+            runs.insert(next, Run{low, low});
+        }
+        ++count;
+    }
+
+    void erase(std::uint16_t low) {
+        auto run = std::prev(run_after(low));
+        if (run->first == run->last) {
+            runs.erase(run);
+        } else if (run->first == low) {
+            ++run->first;
+        } else if (run->last == low) {
+            --run->last;
+        } else {
+            Run tail{static_cast<std::uint16_t>(low + 1), run->last};
+            run->last = static_cast<std::uint16_t>(low - 1);
+            runs.insert(std::next(run), tail);
+        }
+        --count;
+    }
+
+    void append(std::uint16_t low) {
+        if (!runs.empty() && runs.back().last + 1 == low) {
+            runs.back().last = low;
+        } else {
+            runs.push_back(Run{low, low});
+        }
+        ++count;
+    }
+
+    /**
+     * @brief inserts [first, last] as one run merged with its neighbours, none of the ids may be present yet.
+     */
+    void insert_range(std::uint32_t first, std::uint32_t last) {
+        auto next = run_after(first);
+        bool joins_previous = next != runs.begin() && std::prev(next)->last + 1u == first;
+        bool joins_next = next != runs.end() && last + 1 == next->first;
+        if (joins_previous && joins_next) {
+            std::prev(next)->last = next->last;
+            runs.erase(next);
+        } else if (joins_previous) {
+            std::prev(next)->last = static_cast<std::uint16_t>(last);
+        } else if (joins_next) {
+            next->first = static_cast<std::uint16_t>(first);
+        } else {
+            runs.insert(next, Run{static_cast<std::uint16_t>(first), static_cast<std::uint16_t>(last)});
+        }
+        count += last - first + 1;
+    }
+
+    /**
+     * @brief erases [first, last], all of which must be present and therefore lie in a single run.
+     */
+    void erase_range(std::uint32_t first, std::uint32_t last) {
+        auto run = std::prev(run_after(first));
+        if (run->first == first && run->last == last) {
+            runs.erase(run);
+        } else if (run->first == first) {
+            run->first = static_cast<std::uint16_t>(last + 1);
+        } else if (run->last == last) {
+            run->last = static_cast<std::uint16_t>(first - 1);
+        } else {
+            Run tail{static_cast<std::uint16_t>(last + 1), run->last};
+            run->last = static_cast<std::uint16_t>(first - 1);
+            runs.insert(std::next(run), tail);
+        }
+        count -= last - first + 1;
+    }
+
+    std::size_t size() const { return count; }
+    std::size_t bytes() const { return runs.size() * sizeof(Run); }
+    std::size_t run_count() const { return runs.size(); }
+
+    std::uint32_t next_set(std::uint32_t from) const {
+        auto it = run_after(from);
+        if (it != runs.begin() && std::prev(it)->last >= from) {
+            return from;
+        }
+        return it == runs.end() ? roaring_none : it->first;
+    }
+
+    std::uint32_t next_clear(std::uint32_t from) const {
+        auto it = run_after(from);
+        if (it != runs.begin() && std::prev(it)->last >= from) {
+            return std::prev(it)->last + 1u;
+        }
+        return from;
+    }
+
+    template <typename Visitor> void for_each(Visitor visitor) const {
+        for (const Run &run : runs) {
+            for (std::uint32_t low = run.first; low <= run.last; ++low) {
+                visitor(static_cast<std::uint16_t>(low));
+            }
+        }
+    }
+
+  private:
+    struct Run {
+        std::uint16_t first;
+        std::uint16_t last;
+    };
+
+    /**
+     * @brief the first run starting above low.
+     */
+    std::vector<Run>::iterator run_after(std::uint32_t low) {
+        return std::upper_bound(runs.begin(), runs.end(), low, [](std::uint32_t value, const Run &run) {
+            return value < run.first;
+        });
+    }
+    std::vector<Run>::const_iterator run_after(std::uint32_t low) const {
+        return std::upper_bound(runs.begin(), runs.end(), low, [](std::uint32_t value, const Run &run) {
+            return value < run.first;
+        });
+    }
+
+    std::vector<Run> runs;
+    std::size_t count = 0;
+};
+
+} // namespace id_generator_detail
+
+/**
+ * @brief storage keeping the used ids in a roaring bitmap, ids are unbounded up to the largest IdT.
+ *
+ * @details ids are grouped in chunks of 65536 by their high bits, the chunks sit in a vector sorted by key and each
+ * holds its low 16 bits in whichever of a sorted array, a bitmap or a list of runs is smallest. a chunk is re-examined
+ * when its array outgrows 4096 ids, its bitmap drops below 2048 ids, its run list outgrows 2048 runs or it has seen
+ * 4096 changes since the last look, so the choice stays amortized constant time. a chunk that keeps changing only
+ * stays an array or run list while it has few entries, since every change shifts them, otherwise it becomes a bitmap
+ * with constant time inserts and erases. sequentially handed out ids cost a few bytes per chunk rather than tens of
+ * bytes per id in a hash set, and the ids are visited in ascending order.
+ */
+template <typename IdT> class roaring_storage {
+  public:
+    static constexpr bool bounded = false;
+    static constexpr bool concurrent_contains = false;
+    /// the used set is never serialized, so snapshots are interchangeable with hash_set_storage and share its tag.
+    static constexpr std::uint32_t snapshot_tag = 1;
+
+    IdT capacity() const { return std::numeric_limits<IdT>::max(); }
+
+    bool contains(IdT id) const {
+        if (!id_generator_detail::in_range(id, capacity())) {
+            return false;
+        }
+        std::size_t chunk_index = find_chunk(key_of(id));
+        if (chunk_index == chunks.size() || chunks[chunk_index].key != key_of(id)) {
+            return false;
+        }
+        return std::visit([&](const auto &container) { return container.contains(low_of(id)); },
+                          chunks[chunk_index].container);
+    }
+
+    void insert(IdT id) {
+        Key key = key_of(id);
+        std::size_t chunk_index = find_chunk(key);
+        if (chunk_index == chunks.size() || chunks[chunk_index].key != key) {
+            chunks.insert(chunks.begin() + chunk_index, Chunk{key, {}, 0});
+        }
+        last_chunk = chunk_index;
+        Chunk &chunk = chunks[chunk_index];
+        bool reexamine = std::visit(
+            [&](auto &container) {
+                container.insert(low_of(id));
+                using Container = std::decay_t<decltype(container)>;
+                if constexpr (std::is_same_v<Container, id_generator_detail::roaring_array>) {
+                    return container.size() > id_generator_detail::roaring_array::max_size;
+                } else if constexpr (std::is_same_v<Container, id_generator_detail::roaring_runs>) {
+                    return container.run_count() > max_runs;
+                } else {
+                    return false;
+                }
+            },
+            chunk.container);
+        ++used_count;
+        bool periodic = ++chunk.changes == changes_between_checks;
+        if (reexamine || periodic) {
+            optimize(chunk, periodic);
+        }
+    }
+
+    void erase(IdT id) {
+        std::size_t chunk_index = find_chunk(key_of(id));
+        Chunk &chunk = chunks[chunk_index];
+        bool reexamine = std::visit(
+            [&](auto &container) {
+                container.erase(low_of(id));
+                using Container = std::decay_t<decltype(container)>;
+                if constexpr (std::is_same_v<Container, id_generator_detail::roaring_bitmap>) {
+                    return container.size() < id_generator_detail::roaring_array::max_size / 2;
+                } else if constexpr (std::is_same_v<Container, id_generator_detail::roaring_runs>) {
+                    return container.run_count() > max_runs;
+                } else {
+                    return false;
+                }
+            },
+            chunk.container);
+        --used_count;
+        if (std::visit([](const auto &container) { return container.size() == 0; }, chunk.container)) {
+            chunks.erase(chunks.begin() + chunk_index);
+            last_chunk = 0;
+        } else {
+            last_chunk = chunk_index;
+            bool periodic = ++chunk.changes == changes_between_checks;
+            if (reexamine || periodic) {
+                optimize(chunk, periodic);
+            }
+        }
+    }
+
+    /**
+     * @brief inserts the n ids starting at first, none of which may be used yet, as one range per chunk.
+     */
+    void insert_range(IdT first, IdT n) {
+        for_each_chunk_range(first, n, [&](Key key, std::uint32_t low_first, std::uint32_t low_last) {
+            std::size_t chunk_index = find_chunk(key);
+            if (chunk_index == chunks.size() || chunks[chunk_index].key != key) {
+                chunks.insert(chunks.begin() + chunk_index, Chunk{key, {}, 0});
+            }
+            last_chunk = chunk_index;
+            Chunk &chunk = chunks[chunk_index];
+            // a range that would push an array past its limit goes into runs, the cheapest container to grow.
+            auto *array = std::get_if<id_generator_detail::roaring_array>(&chunk.container);
+            std::size_t count = low_last - low_first + 1;
+            if (array != nullptr && array->size() + count > id_generator_detail::roaring_array::max_size) {
+                convert<id_generator_detail::roaring_runs>(chunk);
+            }
+            bool reexamine = std::visit(
+                [&](auto &container) {
+                    container.insert_range(low_first, low_last);
+                    return outgrown(container);
+                },
+                chunk.container);
+            bool periodic = ++chunk.changes == changes_between_checks;
+            if (reexamine || periodic) {
+                optimize(chunk, periodic);
+            }
+        });
+        used_count += static_cast<std::size_t>(n);
+    }
+
+    /**
+     * @brief erases the n ids starting at first, all of which must be used, as one range per chunk.
+     */
+    void erase_range(IdT first, IdT n) {
+        for_each_chunk_range(first, n, [&](Key key, std::uint32_t low_first, std::uint32_t low_last) {
+            std::size_t chunk_index = find_chunk(key);
+            Chunk &chunk = chunks[chunk_index];
+            bool reexamine = std::visit(
+                [&](auto &container) {
+                    container.erase_range(low_first, low_last);
+                    return outgrown(container);
+                },
+                chunk.container);
+            if (std::visit([](const auto &container) { return container.size() == 0; }, chunk.container)) {
+                chunks.erase(chunks.begin() + chunk_index);
+                last_chunk = 0;
+            } else {
+                last_chunk = chunk_index;
+                bool periodic = ++chunk.changes == changes_between_checks;
+                if (reexamine || periodic) {
+                    optimize(chunk, periodic);
+                }
+            }
+        });
+        used_count -= static_cast<std::size_t>(n);
+    }
+
+    /**
+     * @brief marks the ids whose bits are set in used_words as used, starting from id 0, the storage must be empty.
+     * @details every chunk is copied in as a bitmap and converted once, so this is linear in the words.
+     */
+    void assign_words(std::span<const std::uint64_t> used_words) {
+        constexpr std::size_t chunk_words = id_generator_detail::roaring_bitmap::word_count;
+        for (std::size_t first_word = 0; first_word < used_words.size(); first_word += chunk_words) {
+            id_generator_detail::roaring_bitmap bitmap(used_words.subspan(first_word));
+            if (bitmap.size() == 0) {
+                continue;
+            }
+            used_count += bitmap.size();
+            chunks.push_back(Chunk{static_cast<Key>(first_word / chunk_words), std::move(bitmap), 0});
+            optimize(chunks.back());
+        }
+    }
+
+    std::size_t size() const { return used_count; }
+    void reserve(std::size_t) {}
+
+    /**
+     * @brief visits the used ids in ascending order.
+     */
+    template <typename Visitor> void for_each(Visitor visitor) const {
+        for (const Chunk &chunk : chunks) {
+            std::visit(
+                [&](const auto &container) {
+                    container.for_each([&](std::uint16_t low) { visitor(join(chunk.key, low)); });
+                },
+                chunk.container);
+        }
+    }
+
+    /**
+     * @brief the lowest used id in [from, end), or end if there is none.
+     */
+    IdT next_used(IdT from, IdT end) const {
+        if (!(from < end)) {
+            return end;
+        }
+        Key key = key_of(from);
+        for (std::size_t chunk_index = find_chunk(key); chunk_index < chunks.size(); ++chunk_index) {
+            const Chunk &chunk = chunks[chunk_index];
+            std::uint32_t start = chunk.key == key ? low_of(from) : 0;
+            std::uint32_t found =
+                std::visit([&](const auto &container) { return container.next_set(start); }, chunk.container);
+            if (found != id_generator_detail::roaring_none) {
+                IdT id = join(chunk.key, static_cast<std::uint16_t>(found));
+                return id < end ? id : end;
+            }
+        }
+        return end;
+    }
+
+    /**
+     * @brief the lowest unused id in [from, end), or end if there is none, full chunks are skipped whole.
+     */
+    IdT next_unused(IdT from, IdT end) const {
+        while (from < end) {
+            Key key = key_of(from);
+            std::size_t chunk_index = find_chunk(key);
+            if (chunk_index == chunks.size() || chunks[chunk_index].key != key) {
+                return from;
+            }
+            std::uint32_t found = std::visit([&](const auto &container) { return container.next_clear(low_of(from)); },
+                                             chunks[chunk_index].container);
+            if (found != id_generator_detail::roaring_none) {
+                IdT id = join(key, static_cast<std::uint16_t>(found));
+                return id < end ? id : end;
+            }
+            if (key == key_of(std::numeric_limits<IdT>::max())) {
+                return end;
+            }
+            from = join(key + 1, 0);
+        }
+        return end;
+    }
+
+  private:
+    using Key = std::make_unsigned_t<IdT>;
+    using Container =
+        std::variant<id_generator_detail::roaring_array, id_generator_detail::roaring_bitmap,
+                     id_generator_detail::roaring_runs>;
+
+    struct Chunk {
+        Key key;
+        Container container;
+        std::uint16_t changes; ///< inserts and erases since the container was last re-examined.
+        bool churning = false; ///< the last periodic look chose a bitmap because the chunk kept changing.
+    };
+
+    static constexpr std::size_t max_runs = 2048; ///< beyond this many runs a bitmap is always smaller.
+    static constexpr std::uint16_t changes_between_checks = 4096;
+    /// a chunk that keeps changing stays an array or run list only up to this many entries, shifting at most 2KB.
+    static constexpr std::size_t max_churning_entries = 512;
+
+    static Key key_of(IdT id) { return static_cast<Key>(id) >> 16; }
+    static std::uint16_t low_of(IdT id) { return static_cast<std::uint16_t>(static_cast<Key>(id) & 0xffffu); }
+    static IdT join(Key key, std::uint16_t low) { return static_cast<IdT>(static_cast<Key>(key << 16) | low); }
+
+    /**
+     * @brief calls visitor(key, low_first, low_last) for the part of the n ids starting at first in every chunk.
+     */
+    template <typename Visitor> static void for_each_chunk_range(IdT first, IdT n, Visitor visitor) {
+        std::uint64_t position = static_cast<Key>(first);
+        std::uint64_t remaining = static_cast<std::uint64_t>(n);
+        while (remaining != 0) {
+            std::uint32_t low = static_cast<std::uint32_t>(position & 0xffffu);
+            std::uint64_t count = std::min<std::uint64_t>(remaining, id_generator_detail::roaring_chunk_size - low);
+            visitor(static_cast<Key>(position >> 16), low, static_cast<std::uint32_t>(low + count - 1));
+            position += count;
+            remaining -= count;
+        }
+    }
+
+    /**
+     * @brief whether a container has left the size range its kind is meant for, so the chunk should be re-examined.
+     */
+    template <typename Container> static bool outgrown(const Container &container) {
+        if constexpr (std::is_same_v<Container, id_generator_detail::roaring_array>) {
+            return container.size() > id_generator_detail::roaring_array::max_size;
+        } else if constexpr (std::is_same_v<Container, id_generator_detail::roaring_runs>) {
+            return container.run_count() > max_runs;
+        } else {
+            return container.size() < id_generator_detail::roaring_array::max_size / 2;
+        }
+    }
+
+    /**
+     * @brief the index of the chunk with the given key, or of the first chunk above it.
+     */
+    std::size_t find_chunk(Key key) const {
+        if (last_chunk < chunks.size() && chunks[last_chunk].key == key) {
+            return last_chunk;
+        }
+        auto it = std::lower_bound(chunks.begin(), chunks.end(), key,
+                                   [](const Chunk &chunk, Key value) { return chunk.key < value; });
+        return static_cast<std::size_t>(it - chunks.begin());
+    }
+
+    /**
+     * @brief converts the chunk to whichever container holds its ids in the fewest bytes, after changes_between_checks
+     * changes (periodic) arrays and run lists with more than max_churning_entries entries are ruled out.
+     * @note a bitmap chosen that way is kept until the next periodic look, it is not shrunk as its ids are erased.
+     */
+    static void optimize(Chunk &chunk, bool periodic = false) {
+        bool bitmap = std::holds_alternative<id_generator_detail::roaring_bitmap>(chunk.container);
+        if (!periodic && chunk.churning && bitmap) {
+            return;
+        }
+        chunk.changes = 0;
+        auto [size, runs] = std::visit(
+            [](const auto &container) { return std::pair(container.size(), container.run_count()); }, chunk.container);
+        constexpr std::size_t ruled_out = std::numeric_limits<std::size_t>::max();
+        std::size_t array_limit = periodic ? max_churning_entries : id_generator_detail::roaring_array::max_size;
+        std::size_t array_bytes = size <= array_limit ? size * sizeof(std::uint16_t) : ruled_out;
+        std::size_t bitmap_bytes = id_generator_detail::roaring_bitmap::word_count * sizeof(std::uint64_t);
+        std::size_t run_limit = periodic ? max_churning_entries : ruled_out;
+        std::size_t run_bytes = runs <= run_limit ? runs * 2 * sizeof(std::uint16_t) : ruled_out;
+        chunk.churning = periodic && bitmap_bytes < array_bytes && bitmap_bytes < run_bytes;
+
+        if (run_bytes <= array_bytes && run_bytes <= bitmap_bytes) {
+            convert<id_generator_detail::roaring_runs>(chunk);
+        } else if (array_bytes <= bitmap_bytes) {
+            convert<id_generator_detail::roaring_array>(chunk);
+        } else {
+            convert<id_generator_detail::roaring_bitmap>(chunk);
+        }
+    }
+
+    template <typename Target> static void convert(Chunk &chunk) {
+        if (std::holds_alternative<Target>(chunk.container)) {
+            return;
+        }
+        Target target;
+        std::visit([&](const auto &container) { container.for_each([&](std::uint16_t low) { target.append(low); }); },
+                   chunk.container);
+        chunk.container = std::move(target);
+    }
+
+    std::vector<Chunk> chunks;   ///< sorted by key, every chunk holds at least one id.
+    std::size_t used_count = 0;
+    std::size_t last_chunk = 0; ///< the chunk touched by the last insert or erase, checked before searching.
+};
+
+namespace id_generator_detail {
+
+/**
+ * @brief summary levels over words kept elsewhere, a bit is set when the word below it is all ones, so the first word
+ * with a clear bit at or after any word is found with one count-trailing-zero per level, O(log64 n).
+ * @note zeroed means that no word is full, so the levels are allocated with calloc and construction is constant time.
+ */
+class FullWordIndex {
+  public:
+    explicit FullWordIndex(std::size_t word_count) : indexed_words(word_count) {
+        std::size_t total_words = 0;
+        for (std::size_t bits = word_count;; bits = levels.back().word_count) {
+            levels.push_back(Level{total_words, (bits + 63) / 64});
+            total_words += levels.back().word_count;
+            if (levels.back().word_count <= 1) {
+                break;
+            }
+        }
+        buffer = allocate_zeroed<std::uint64_t>(total_words);
+    }
+
+    FullWordIndex(const FullWordIndex &other)
+        : indexed_words(other.indexed_words), levels(other.levels),
+          buffer(allocate_zeroed<std::uint64_t>(other.total_words())) {
+        std::memcpy(buffer.get(), other.buffer.get(), total_words() * sizeof(std::uint64_t));
+    }
+
+    FullWordIndex &operator=(const FullWordIndex &other) {
+        if (this != &other) {
+            *this = FullWordIndex(other);
+        }
+        return *this;
+    }
+
+    FullWordIndex(FullWordIndex &&) noexcept = default;
+    FullWordIndex &operator=(FullWordIndex &&) noexcept = default;
+
+    /**
+     * @brief records that word word_index is now all ones.
+     */
+    void set_full(std::size_t word_index) {
+        // a summary word that becomes all ones in turn sets its bit in the level above.
+        for (std::size_t level = 0, index = word_index; level < levels.size(); ++level, index /= 64) {
+            std::uint64_t &word = level_words(level)[index / 64];
+            word |= std::uint64_t(1) << (index % 64);
+            if (word != ~std::uint64_t(0)) {
+                break;
+            }
+        }
+    }
+
+    /**
+     * @brief records that word word_index is no longer all ones.
+     */
+    void clear_full(std::size_t word_index) {
+        for (std::size_t level = 0, index = word_index; level < levels.size(); ++level, index /= 64) {
+            std::uint64_t &word = level_words(level)[index / 64];
+            bool was_full = word == ~std::uint64_t(0);
+            word &= ~(std::uint64_t(1) << (index % 64));
+            if (!was_full) {
+                break;
+            }
+        }
+    }
+
+    /**
+     * @brief the lowest word at or after word_index that is not all ones, or the word count if there is none.
+     * @details climbs while the rest of the current summary word is full, then descends through the lowest clear bit
+     * of every level below. the clear bits past the last entry of a level are padding, nothing after them is open.
+     */
+    std::size_t find_next_not_full(std::size_t word_index) const {
+        std::size_t index = word_index;
+        std::size_t level = 0;
+        while (true) {
+            std::size_t summary_index = index / 64;
+            if (summary_index >= levels[level].word_count) {
+                return indexed_words;
+            }
+            std::uint64_t open = ~level_words(level)[summary_index] & (~std::uint64_t(0) << (index % 64));
+            if (open != 0) {
+                index = summary_index * 64 + std::countr_zero(open);
+                break;
+            }
+            if (++level == levels.size()) {
+                return indexed_words;
+            }
+            index = summary_index + 1;
+        }
+        while (true) {
+            if (index >= entry_count(level)) {
+                return indexed_words;
+            }
+            if (level == 0) {
+                return index;
+            }
+            --level;
+            index = index * 64 + std::countr_zero(~level_words(level)[index]);
+        }
+    }
+
+    /**
+     * @brief recomputes every level from the indexed words, which is linear in the words.
+     */
+    void rebuild(const std::uint64_t *words) {
+        std::memset(buffer.get(), 0, total_words() * sizeof(std::uint64_t));
+        for (std::size_t level = 0; level < levels.size(); ++level) {
+            const std::uint64_t *below = level == 0 ? words : level_words(level - 1);
+            std::uint64_t *summary = level_words(level);
+            for (std::size_t entry = 0; entry < entry_count(level); ++entry) {
+                if (below[entry] == ~std::uint64_t(0)) {
+                    summary[entry / 64] |= std::uint64_t(1) << (entry % 64);
+                }
+            }
+        }
+    }
+
+  private:
+    struct Level {
+        std::size_t offset;     ///< of the level's first word in the buffer.
+        std::size_t word_count;
+    };
+
+    std::uint64_t *level_words(std::size_t level) { return buffer.get() + levels[level].offset; }
+    const std::uint64_t *level_words(std::size_t level) const { return buffer.get() + levels[level].offset; }
+    std::size_t total_words() const { return levels.back().offset + levels.back().word_count; }
+
+    /**
+     * @brief the number of bits in use in a level, one per word of the level below.
+     */
+    std::size_t entry_count(std::size_t level) const {
+        return level == 0 ? indexed_words : levels[level - 1].word_count;
+    }
+
+    std::size_t indexed_words;
+    std::vector<Level> levels; ///< one bit per indexed word first, then every level above up to one word.
+    ZeroedArray<std::uint64_t> buffer;
+};
+
+/**
+ * @return the index of the first of the ascending interleaved (first, length) runs that starts after id.
+ */
+template <typename IdT> std::size_t first_run_after(const std::vector<IdT> &runs, IdT id) {
+    std::size_t low = 0;
+    std::size_t high = runs.size() / 2;
+    while (low < high) {
+        std::size_t middle = low + (high - low) / 2;
+        if (runs[2 * middle] <= id) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+/**
+ * @return one past the run holding id, or id itself if none of the runs holds it.
+ */
+template <typename IdT> IdT end_of_run(const std::vector<IdT> &runs, IdT id) {
+    std::size_t after = first_run_after(runs, id);
+    if (after == 0) {
+        return id;
+    }
+    IdT first = runs[2 * after - 2];
+    IdT length = runs[2 * after - 1];
+    return id - first < length ? first + length : id;
+}
+
+/**
+ * @return the first id of the first run starting after id, or end if that is not below end.
+ */
+template <typename IdT> IdT next_run_start(const std::vector<IdT> &runs, IdT id, IdT end) {
+    std::size_t after = first_run_after(runs, id);
+    return after < runs.size() / 2 && runs[2 * after] < end ? runs[2 * after] : end;
+}
+
+} // namespace id_generator_detail
+
+template <typename IdT> class bitmap_storage;
+
+/**
+ * @brief an immutable view of a bitmap_storage's used ids, taken in constant time and safe to read from any thread
+ * while the owner keeps allocating and reclaiming, it stays valid after the generator is gone. ids that were
+ * quarantined when it was taken are neither used nor free, they are copied into the snapshot as runs.
+ *
+ * @details the snapshot reads the live words in place. before the owner first writes a page of words after the
+ * snapshot was taken it copies the page and publishes the copy in the snapshot's saved page slot with a release store,
+ * which happens before the write itself. a reader therefore uses the saved page when there is one, and otherwise reads
+ * the live word and checks the slot again, a live word written after the snapshot is only visible once its saved
+ * page is.
+ */
+template <typename IdT> class bitmap_snapshot {
+  public:
+    static constexpr std::size_t page_words = 64; ///< words copied together on the first write, 4096 ids.
+
+    bool is_used(IdT id) const {
+        if (!id_generator_detail::in_range(id, state->capacity)) {
+            return false;
+        }
+        std::size_t index = static_cast<std::size_t>(id);
+        return (word(index / 64) >> (index % 64)) & 1u;
+    }
+
+    std::size_t get_used_count() const { return state->used_count; }
+    std::size_t get_quarantined_count() const { return state->quarantined_count; }
+    std::size_t get_free_count() const {
+        return static_cast<std::size_t>(state->capacity) - state->used_count - state->quarantined_count;
+    }
+    IdT get_capacity() const { return state->capacity; }
+    IdT get_high_water_mark() const { return state->high_water_mark; }
+
+    /**
+     * @brief visits the used ids in ascending order, skipping empty words.
+     */
+    template <typename Visitor> void for_each_used(Visitor visitor) const {
+        std::size_t word_end = (static_cast<std::size_t>(state->high_water_mark) + 63) / 64;
+        for (std::size_t word_index = 0; word_index < word_end; ++word_index) {
+            for (std::uint64_t bits = word(word_index); bits != 0; bits &= bits - 1) {
+                visitor(static_cast<IdT>(word_index * 64 + std::countr_zero(bits)));
+            }
+        }
+    }
+
+    /**
+     * @brief visits the free ids below the capacity in ascending order, skipping full words and quarantined runs.
+     */
+    template <typename Visitor> void for_each_free(Visitor visitor) const {
+        std::size_t capacity = static_cast<std::size_t>(state->capacity);
+        const std::vector<IdT> &quarantined_runs = state->quarantined_runs;
+        std::size_t run = 0;
+        for (std::size_t word_index = 0; word_index * 64 < capacity; ++word_index) {
+            for (std::uint64_t bits = ~word(word_index); bits != 0; bits &= bits - 1) {
+                std::size_t index = word_index * 64 + std::countr_zero(bits);
+                if (index >= capacity) {
+                    break;
+                }
+                IdT id = static_cast<IdT>(index);
+                while (run < quarantined_runs.size() && id >= quarantined_runs[run] + quarantined_runs[run + 1]) {
+                    run += 2;
+                }
+                if (run == quarantined_runs.size() || id < quarantined_runs[run]) {
+                    visitor(id);
+                }
+            }
+        }
+    }
+
+  private:
+    friend class bitmap_storage<IdT>;
+
+    struct State {
+        std::shared_ptr<std::uint64_t[]> live_words;
+        id_generator_detail::ZeroedArray<const std::uint64_t *> saved_pages; ///< null until the page is first written.
+        std::vector<std::shared_ptr<std::uint64_t[]>> page_copies; ///< owns the saved pages, touched by the owner only.
+        IdT capacity;
+        IdT high_water_mark;
+        std::size_t used_count;
+        std::vector<IdT> quarantined_runs; ///< interleaved (first, length) pairs in ascending order.
+        std::size_t quarantined_count;
+    };
+
+    explicit bitmap_snapshot(std::shared_ptr<const State> state) : state(std::move(state)) {}
+
+    std::uint64_t word(std::size_t word_index) const {
+        std::atomic_ref saved_slot(state->saved_pages[word_index / page_words]);
+        const std::uint64_t *saved = saved_slot.load(std::memory_order_acquire);
+        if (saved == nullptr) {
+            std::uint64_t live = std::atomic_ref(state->live_words[word_index]).load(std::memory_order_acquire);
+            saved = saved_slot.load(std::memory_order_acquire);
+            if (saved == nullptr) {
+                return live;
+            }
+        }
+        return saved[word_index % page_words];
+    }
+
+    std::shared_ptr<const State> state;
+};
+
+/**
+ * @brief storage keeping one bit per id in [0, capacity), allocated with calloc so construction is constant time.
+ * @details the words are written through atomic_ref with release stores, so contains can be called from other threads
+ * while a single owner thread inserts and erases. every other member belongs to the owner. the words are shared with
+ * the snapshots taken of the storage, and while any snapshot is alive the first write to each page after a snapshot
+ * copies that page for it first.
+ */
+template <typename IdT> class bitmap_storage {
+  public:
+    static constexpr bool bounded = true;
+    static constexpr bool concurrent_contains = true; ///< contains may run on other threads while the owner writes.
+    static constexpr std::uint32_t snapshot_tag = 2;
+
+    explicit bitmap_storage(IdT capacity)
+        : id_capacity(validated_capacity(capacity)),
+          words(id_generator_detail::allocate_zeroed<std::uint64_t>(word_count())), full_words(word_count()) {}
+
+    bitmap_storage(const bitmap_storage &other)
+        : id_capacity(other.id_capacity), used_count(other.used_count),
+          words(id_generator_detail::allocate_zeroed<std::uint64_t>(word_count())), full_words(other.full_words) {
+        std::memcpy(words.get(), other.words.get(), word_count() * sizeof(std::uint64_t));
+    }
+
+    bitmap_storage &operator=(const bitmap_storage &other) {
+        if (this != &other) {
+            *this = bitmap_storage(other);
+        }
+        return *this;
+    }
+
+    bitmap_storage(bitmap_storage &&) noexcept = default;
+    bitmap_storage &operator=(bitmap_storage &&) noexcept = default;
+
+    IdT capacity() const { return id_capacity; }
+    bool contains(IdT id) const {
+        if (!id_generator_detail::in_range(id, id_capacity)) {
+            return false;
+        }
+        std::size_t index = static_cast<std::size_t>(id);
+        return (std::atomic_ref(words[index / 64]).load(std::memory_order_acquire) >> (index % 64)) & 1u;
+    }
+    void insert(IdT id) {
+        std::size_t index = static_cast<std::size_t>(id);
+        store_word(index / 64, words[index / 64] | (std::uint64_t(1) << (index % 64)));
+        ++used_count;
+    }
+    void erase(IdT id) {
+        std::size_t index = static_cast<std::size_t>(id);
+        store_word(index / 64, words[index / 64] & ~(std::uint64_t(1) << (index % 64)));
+        --used_count;
+    }
+
+    /**
+     * @brief inserts the n ids starting at first, none of which may be used yet, a word at a time.
+     */
+    void insert_range(IdT first, IdT n) {
+        fill(first, n, true);
+        used_count += static_cast<std::size_t>(n);
+    }
+
+    /**
+     * @brief erases the n ids starting at first, all of which must be used, a word at a time.
+     */
+    void erase_range(IdT first, IdT n) {
+        fill(first, n, false);
+        used_count -= static_cast<std::size_t>(n);
+    }
+
+    /**
+     * @brief marks the ids whose bits are set in used_words as used, starting from id 0, the storage must be empty
+     * and have no snapshots.
+     */
+    void assign_words(std::span<const std::uint64_t> used_words) {
+        std::size_t copied_words = std::min(used_words.size(), word_count());
+        if (copied_words != 0) {
+            std::memcpy(words.get(), used_words.data(), copied_words * sizeof(std::uint64_t));
+        }
+        used_count = 0;
+        for (std::size_t word_index = 0; word_index < copied_words; ++word_index) {
+            used_count += static_cast<std::size_t>(std::popcount(used_words[word_index]));
+        }
+        full_words.rebuild(words.get());
+    }
+
+    /**
+     * @brief hints that the word holding id is about to be written.
+     */
+    void prefetch(IdT id) const {
+        if (id_generator_detail::in_range(id, id_capacity)) {
+            id_generator_detail::prefetch_for_write(&words[static_cast<std::size_t>(id) / 64]);
+        }
+    }
+
+    std::size_t size() const { return used_count; }
+    void reserve(std::size_t) {}
+
+    /**
+     * @brief visits the used ids in ascending order, skipping empty words.
+     */
+    template <typename Visitor> void for_each(Visitor visitor) const {
+        for (std::size_t word_index = 0; word_index < word_count(); ++word_index) {
+            for (std::uint64_t word = words[word_index]; word != 0; word &= word - 1) {
+                visitor(static_cast<IdT>(word_index * 64 + std::countr_zero(word)));
+            }
+        }
+    }
+
+    /**
+     * @brief the lowest used id in [from, end), or end if there is none, skipping empty words.
+     */
+    IdT next_used(IdT from, IdT end) const { return find_next(from, end, 0); }
+
+    /**
+     * @brief the lowest unused id in [from, end), or end if there is none, full words are skipped through the full
+     * word index in O(log64 n).
+     */
+    IdT next_unused(IdT from, IdT end) const {
+        if (!(from < end)) {
+            return end;
+        }
+        std::size_t index = static_cast<std::size_t>(from);
+        std::size_t word_index = index / 64;
+        std::uint64_t open = ~words[word_index] & (~std::uint64_t(0) << (index % 64));
+        if (open == 0) {
+            word_index = full_words.find_next_not_full(word_index + 1);
+            if (word_index >= word_count()) {
+                return end;
+            }
+            open = ~words[word_index];
+        }
+        return static_cast<IdT>(std::min(static_cast<std::size_t>(end), word_index * 64 + std::countr_zero(open)));
+    }
+
+    /**
+     * @brief one past the highest used id below end, or 0 if there is none, skipping empty words backwards.
+     */
+    IdT used_end(IdT end) const {
+        std::size_t index = static_cast<std::size_t>(end);
+        while (index > 0) {
+            std::size_t word_index = (index - 1) / 64;
+            std::uint64_t used = words[word_index] & id_generator_detail::bit_mask(0, index - word_index * 64);
+            if (used != 0) {
+                return static_cast<IdT>(word_index * 64 + 64 - std::countl_zero(used));
+            }
+            index = word_index * 64;
+        }
+        return IdT(0);
+    }
+
+    /**
+     * @brief takes a constant time copy-on-write snapshot of the used ids.
+     * @param high_water_mark recorded in the snapshot, it bounds the ids the snapshot visits as used.
+     * @param quarantined_runs the unused ids that are not free either, as ascending interleaved (first, length) pairs.
+     */
+    bitmap_snapshot<IdT> snapshot(IdT high_water_mark, std::vector<IdT> quarantined_runs = {}) {
+        using State = typename bitmap_snapshot<IdT>::State;
+        std::erase_if(snapshots, [](const std::weak_ptr<State> &snapshot) { return snapshot.expired(); });
+        if (!page_generations) {
+            page_generations = id_generator_detail::allocate_zeroed<std::uint64_t>(page_count());
+        }
+        ++generation;
+
+        std::size_t quarantined_count = 0;
+        for (std::size_t i = 1; i < quarantined_runs.size(); i += 2) {
+            quarantined_count += static_cast<std::size_t>(quarantined_runs[i]);
+        }
+        auto state = std::make_shared<State>(
+            State{words, id_generator_detail::allocate_zeroed<const std::uint64_t *>(page_count()), {}, id_capacity,
+                  high_water_mark, used_count, std::move(quarantined_runs), quarantined_count});
+        snapshots.push_back(state);
+        return bitmap_snapshot<IdT>(std::move(state));
+    }
+
+  private:
+    static constexpr std::size_t page_words = bitmap_snapshot<IdT>::page_words;
+
+    /**
+     * @brief copies the page holding word_index into every alive snapshot that still reads it in place, once per
+     * page and snapshot generation.
+     */
+    void preserve_page(std::size_t word_index) {
+        if (snapshots.empty()) {
+            return;
+        }
+        std::size_t page = word_index / page_words;
+        if (page_generations[page] == generation) {
+            return;
+        }
+        page_generations[page] = generation;
+
+        std::shared_ptr<std::uint64_t[]> copy;
+        std::erase_if(snapshots, [&](const auto &weak_snapshot) {
+            auto snapshot = weak_snapshot.lock();
+            if (!snapshot) {
+                return true;
+            }
+            std::atomic_ref saved_slot(snapshot->saved_pages[page]);
+            if (saved_slot.load(std::memory_order_relaxed) == nullptr) {
+                if (!copy) {
+                    std::size_t first_word = page * page_words;
+                    std::size_t copied_words = std::min(page_words, word_count() - first_word);
+                    copy = id_generator_detail::allocate_zeroed<std::uint64_t>(page_words);
+                    std::memcpy(copy.get(), words.get() + first_word, copied_words * sizeof(std::uint64_t));
+                }
+                snapshot->page_copies.push_back(copy);
+                saved_slot.store(copy.get(), std::memory_order_release);
+            }
+            return false;
+        });
+    }
+
+    void fill(IdT first, IdT n, bool value) {
+        std::size_t index = static_cast<std::size_t>(first);
+        std::size_t end = index + static_cast<std::size_t>(n);
+        while (index < end) {
+            std::size_t word_end = std::min(end, (index / 64 + 1) * 64);
+            std::uint64_t mask = id_generator_detail::bit_mask(index, word_end - index);
+            std::uint64_t bits = words[index / 64];
+            store_word(index / 64, value ? bits | mask : bits & ~mask);
+            index = word_end;
+        }
+    }
+
+    /**
+     * @brief publishes a new value of an owned word after preserving its page, keeping the full word index in step.
+     */
+    void store_word(std::size_t word_index, std::uint64_t value) {
+        preserve_page(word_index);
+        bool was_full = words[word_index] == ~std::uint64_t(0);
+        std::atomic_ref(words[word_index]).store(value, std::memory_order_release);
+        if (value == ~std::uint64_t(0)) {
+            full_words.set_full(word_index);
+        } else if (was_full) {
+            full_words.clear_full(word_index);
+        }
+    }
+
+    /**
+     * @brief the lowest id in [from, end) whose bit differs from the matching bit of flip, end must not exceed the
+     * capacity.
+     */
+    IdT find_next(IdT from, IdT end, std::uint64_t flip) const {
+        if (!(from < end)) {
+            return end;
+        }
+        return static_cast<IdT>(id_generator_detail::find_next_bit(words.get(), static_cast<std::size_t>(from),
+                                                                   static_cast<std::size_t>(end), flip));
+    }
+
+    static IdT validated_capacity(IdT capacity) {
+        if (!(capacity > 0)) {
+            throw std::invalid_argument("max_value must be greater than 0");
+        }
+        return capacity;
+    }
+
+    std::size_t word_count() const { return (static_cast<std::size_t>(id_capacity) + 63) / 64; }
+    std::size_t page_count() const { return (word_count() + page_words - 1) / page_words; }
+
+    IdT id_capacity;
+    std::size_t used_count = 0;
+    std::shared_ptr<std::uint64_t[]> words; ///< shared with the snapshots, which keep reading it in place.
+    id_generator_detail::FullWordIndex full_words; ///< owned by the writer, snapshots never search for unused ids.
+    std::vector<std::weak_ptr<typename bitmap_snapshot<IdT>::State>> snapshots;
+    id_generator_detail::ZeroedArray<std::uint64_t> page_generations; ///< the generation each page was last saved in.
+    std::uint64_t generation = 0; ///< bumped by every snapshot, so pages are saved again for the new snapshot.
+};
+
+/**
+ * @brief hands out unique ids of type IdT, reclaimed ids are reused in the order chosen by ReusePolicy and the ids in
+ * use are tracked by Storage.
+ *
+ * @details ids that were never handed out come from a high-water counter (next_id), reclaimed ids go to the reuse
+ * policy and ids released through free_range are kept as merged intervals, which allocate_range reuses best fit and
+ * get_id reuses after the reuse policy, or in id order with it when it compacts. a policy keeping intervals itself
+ * holds the free ranges as well. the policies are plain members so every call on them inlines, and the class is final
+ * so calls through the concrete type are never dispatched virtually, even for int ids where it still implements
+ * IDGenerator.
+ *
+ * a ReusePolicy provides push, pop, empty, size, for_each (in pop order), save and load(is, limit), and declares
+ * whether it compacts. a compacting policy hands out its smallest id first and also provides front, contains and
+ * erase, optionally trim_back, get_id then takes the lowest of its ids and the free ranges, and the high-water mark is
+ * lowered whenever the ids just below it are all free. a policy that keeps intervals may provide push_range and
+ * allocate, it then holds the free ranges too. a policy that holds ids back may provide quarantine_range(first, n,
+ * release_range) for free_range and advance_epoch(release_range), handing ranges back through release_range(first,
+ * n). a policy declaring derived_from_storage keeps no ids at all, every unused id below the high-water mark is free
+ * and found through the storage. a Storage provides capacity, contains, insert, erase, insert_range, erase_range,
+ * size, reserve, for_each, next_used and next_unused, optionally prefetch and used_end, and declares whether it is
+ * bounded, bounded storages are constructed from their capacity.
+ *
+ * runtime counters are kept with single writer relaxed atomics and can be read through get_counters from any thread,
+ * defining UNIQUE_ID_GENERATOR_NO_COUNTERS removes them.
+ */
+template <typename IdT, typename ReusePolicy = fifo_reuse<IdT>, typename Storage = roaring_storage<IdT>>
+class basic_id_generator final : public id_generator_detail::InterfaceFor<IdT> {
+  public:
+    using id_type = IdT;
+
+    basic_id_generator()
+        requires(!Storage::bounded)
+    {
+        record_levels();
+    }
+
+    explicit basic_id_generator(IdT max_value)
+        requires(Storage::bounded)
+        : storage(max_value) {
+        record_levels();
+    }
+
+    explicit basic_id_generator(ReusePolicy reuse)
+        requires(!Storage::bounded)
+        : reuse(std::move(reuse)) {
+        record_levels();
+    }
+
+    basic_id_generator(IdT max_value, ReusePolicy reuse)
+        requires(Storage::bounded)
+        : storage(max_value), reuse(std::move(reuse)) {
+        record_levels();
+    }
+
+    basic_id_generator(Storage storage, ReusePolicy reuse) : storage(std::move(storage)), reuse(std::move(reuse)) {
+        record_levels();
+    }
+
+    IdT get_id() {
+        IdT id = take_free_id();
+        storage.insert(id);
+        counters.add_allocations(1);
+        record_levels();
+        return id;
+    }
+
+    void reclaim_id(IdT id_value) {
+        if (!storage.contains(id_value)) {
+            counters.add_failed_reclaim();
+            throw std::invalid_argument("Invalid or already reclaimed ID: " + std::to_string(id_value));
+        }
+        storage.erase(id_value);
+        if constexpr (!reuse_from_storage) {
+            reuse.push(id_value);
+        }
+        compact();
+        counters.add_reclaims(1);
+        record_levels();
+    }
+
+    /**
+     * @brief hands out n ids, reused ones first and the rest as one block from the counter, growing the storage once
+     * up front.
+     * @details reused ids are inserted one by one with the storage prefetched a few ids ahead, the block from the
+     * counter is inserted as a single range.
+     * @throws std::runtime_error without handing out anything when fewer than n ids are free.
+     */
+    void get_ids(std::size_t n, std::span<IdT> out) {
+        id_generator_detail::check_batch_size(n, out);
+        if (!has_free_ids(n)) {
+            counters.add_exhaustion_event();
+            throw std::runtime_error("Maximum ID limit reached");
+        }
+        storage.reserve(storage.size() + n);
+        std::size_t reused = 0;
+        if constexpr (reuse_from_storage) {
+            // each search for the lowest unused id starts past the one inserted before it.
+            for (IdT from = 0; reused < n && has_reusable_id(); ++reused) {
+                out[reused] = storage.next_unused(from, next_id);
+                drop_free_range_front(out[reused]);
+                storage.insert(out[reused]);
+                from = out[reused] + 1;
+            }
+        }
+        while (reused < n && has_reusable_id()) {
+            // popped a block at a time, so each id's storage is prefetched a block before it is inserted.
+            std::size_t block_first = reused;
+            std::size_t block_end = std::min(n, reused + prefetch_distance);
+            for (; reused < block_end && has_reusable_id(); ++reused) {
+                out[reused] = pop_reusable_id();
+                prefetch_storage(out[reused]);
+            }
+            for (std::size_t i = block_first; i < reused; ++i) {
+                storage.insert(out[i]);
+            }
+        }
+        if (reused < n) {
+            IdT first = next_id;
+            IdT count = static_cast<IdT>(n - reused);
+            next_id += count;
+            std::iota(out.begin() + reused, out.begin() + n, first);
+            storage.insert_range(first, count);
+        }
+        counters.add_allocations(n);
+        record_levels();
+    }
+
+    /**
+     * @brief reclaims every id in ids in order, prefetching the storage a few ids ahead, if one of them is rejected
+     * the ones before it stay reclaimed.
+     */
+    void reclaim_ids(std::span<const IdT> ids) {
+        for (std::size_t i = 0; i < ids.size(); ++i) {
+            if (i + prefetch_distance < ids.size()) {
+                prefetch_storage(ids[i + prefetch_distance]);
+            }
+            reclaim_id(ids[i]);
+        }
+    }
+
+    /**
+     * @brief hands out n consecutive ids, the first of which is a multiple of alignment.
+     * @details ranges come from previously freed ranges (best fit) before the counter is advanced, ids skipped over to
+     * align the counter become a free range. single reclaimed ids are only searched for runs when the reuse policy
+     * keeps them as intervals, so this is logarithmic in the number of free ranges.
+     * @throws std::runtime_error if neither a freed range nor the space above the counter can hold the range.
+     * @return the first id of the range.
+     */
+    IdT allocate_range(IdT n, IdT alignment = 1) {
+        id_generator_detail::check_range_arguments(n, alignment);
+        std::optional<IdT> reused;
+        if constexpr (requires { reuse.allocate(n, alignment); }) {
+            reused = reuse.allocate(n, alignment);
+        } else {
+            reused = free_ranges.allocate(n, alignment);
+        }
+        IdT first;
+        if (reused) {
+            first = *reused;
+        } else {
+            IdT remaining = storage.capacity() - next_id;
+            IdT misalignment = next_id % alignment;
+            IdT padding = misalignment == 0 ? IdT(0) : IdT(alignment - misalignment);
+            if (padding > remaining || n > remaining - padding) {
+                counters.add_exhaustion_event();
+                throw std::runtime_error("Maximum ID limit reached");
+            }
+            first = next_id + padding;
+            if (padding > 0) {
+                add_free_range(next_id, padding);
+            }
+            next_id = first + n;
+        }
+        storage.reserve(storage.size() + static_cast<std::size_t>(n));
+        storage.insert_range(first, n);
+        counters.add_allocations(static_cast<std::uint64_t>(n));
+        record_levels();
+        return first;
+    }
+
+    /**
+     * @brief reclaims the n ids starting at first, merging them with neighbouring free ranges, a quarantining reuse
+     * policy holds them as one run until their quarantine is over.
+     * @throws std::invalid_argument without reclaiming anything if any id in the range is not in use.
+     */
+    void free_range(IdT first, IdT n) {
+        id_generator_detail::check_range_arguments(n, IdT(1));
+        if (!id_generator_detail::in_range(first, next_id) || n > next_id - first) {
+            counters.add_failed_reclaim();
+            throw std::invalid_argument("Invalid or already reclaimed ID: " + std::to_string(first));
+        }
+        if (IdT unused = storage.next_unused(first, first + n); unused != first + n) {
+            counters.add_failed_reclaim();
+            throw std::invalid_argument("Invalid or already reclaimed ID: " + std::to_string(unused));
+        }
+        storage.erase_range(first, n);
+        if constexpr (requires { reuse.quarantine_range(first, n, release_range()); }) {
+            reuse.quarantine_range(first, n, release_range());
+        } else {
+            add_free_range(first, n);
+        }
+        compact();
+        counters.add_reclaims(static_cast<std::uint64_t>(n));
+        record_levels();
+    }
+
+    /**
+     * @brief every id handed out so far is below this, so it is the size an array indexed by id needs.
+     */
+    IdT get_high_water_mark() const { return next_id; }
+
+    /**
+     * @brief advances the reuse policy's epoch, releasing the ids whose quarantine is over.
+     */
+    void advance_epoch()
+        requires requires(ReusePolicy &policy, void (*release)(IdT, IdT)) { policy.advance_epoch(release); }
+    {
+        reuse.advance_epoch(release_range());
+        compact();
+        record_levels();
+    }
+
+    /**
+     * @brief whether id is currently handed out, for the owner thread only, constant time on bitmap_storage and
+     * hash_set_storage, a binary search inside the id's chunk on roaring_storage.
+     */
+    bool contains(IdT id) const { return storage.contains(id); }
+
+    /**
+     * @brief whether id is currently handed out, a single wait-free load that may be called from other threads while
+     * one owner thread allocates and reclaims.
+     */
+    bool is_used(IdT id) const
+        requires(Storage::concurrent_contains)
+    {
+        return storage.contains(id);
+    }
+
+    /**
+     * @brief an immutable view of the used and free ids taken in constant time, which other threads can read while
+     * this one keeps allocating, only the pages written afterwards are copied. a quarantining reuse policy's runs are
+     * copied into it so they count as neither used nor free.
+     */
+    auto snapshot()
+        requires requires(Storage &storage, IdT high_water_mark) { storage.snapshot(high_water_mark); }
+    {
+        if constexpr (quarantines) {
+            return storage.snapshot(next_id, reuse.quarantined_runs());
+        } else {
+            return storage.snapshot(next_id);
+        }
+    }
+
+    /**
+     * @brief reads the used and free counts, high-water mark and capacity as of the last change, consistent with each
+     * other and safe to call from any thread while the generator is in use.
+     */
+    IDGeneratorStats get_stats() const { return stats.read(); }
+
+    /**
+     * @brief reads the runtime counters, safe to call from any thread while the generator is in use.
+     */
+    IDGeneratorCounters get_counters() const { return counters.read(); }
+
+    /**
+     * @brief logs the runtime counters through logger.info as a single line.
+     */
+    template <typename Logger> void log_counters(Logger &logger, const std::string &name = "id generator") const {
+        id_generator_detail::log_counters(logger, name, get_counters());
+    }
+
+    /**
+     * @brief a forward iterator over the used (Used true) or free ids in ascending order that walks the storage
+     * directly, it is invalidated by any change to the generator and must not outlive its id_range.
+     */
+    template <bool Used> class id_iterator {
+      public:
+        using iterator_concept = std::forward_iterator_tag;
+        using iterator_category = std::input_iterator_tag;
+        using value_type = IdT;
+        using difference_type = std::ptrdiff_t;
+        using reference = IdT;
+
+        id_iterator() = default;
+
+        IdT operator*() const { return id; }
+        id_iterator &operator++() {
+            id = generator->template next_id_from<Used>(id + 1, generator->template id_limit<Used>(), *skipped);
+            return *this;
+        }
+        id_iterator operator++(int) {
+            id_iterator previous = *this;
+            ++*this;
+            return previous;
+        }
+        friend bool operator==(const id_iterator &a, const id_iterator &b) {
+            return a.generator == b.generator && a.id == b.id;
+        }
+
+      private:
+        friend class basic_id_generator;
+        id_iterator(const basic_id_generator *generator, const std::vector<IdT> *skipped, IdT id)
+            : generator(generator), skipped(skipped), id(id) {}
+
+        const basic_id_generator *generator = nullptr;
+        const std::vector<IdT> *skipped = nullptr; ///< the quarantined runs held by the id_range.
+        IdT id{};
+    };
+
+    template <bool Used> class id_range {
+      public:
+        id_iterator<Used> begin() const {
+            return {generator, &skipped,
+                    generator->template next_id_from<Used>(IdT(0), generator->template id_limit<Used>(), skipped)};
+        }
+        id_iterator<Used> end() const { return {generator, &skipped, generator->template id_limit<Used>()}; }
+
+      private:
+        friend class basic_id_generator;
+        explicit id_range(const basic_id_generator *generator)
+            : generator(generator), skipped(Used ? std::vector<IdT>() : generator->quarantined_runs()) {}
+
+        const basic_id_generator *generator;
+        std::vector<IdT> skipped; ///< the quarantined runs, which are not free.
+    };
+
+    /**
+     * @brief the used ids in ascending order, e.g. for (int id : generator.used_ids()), without allocating.
+     */
+    id_range<true> used_ids() const { return id_range<true>(this); }
+
+    /**
+     * @brief the free ids in ascending order, for unbounded storages only those below the high-water mark. only a
+     * quarantining policy allocates, to sort its quarantined runs once up front.
+     */
+    id_range<false> free_ids() const { return id_range<false>(this); }
+
+    /**
+     * @brief visits the used ids in ascending order, a run at a time.
+     */
+    template <typename Visitor> void for_each_used(Visitor visitor) const {
+        for_each_run<true>([&](IdT first, IdT end) {
+            for (IdT id = first; id < end; ++id) {
+                visitor(id);
+            }
+        });
+    }
+
+    /**
+     * @brief visits the free ids in ascending order, a run at a time, for unbounded storages only those below the
+     * high-water mark.
+     */
+    template <typename Visitor> void for_each_free(Visitor visitor) const {
+        for_each_run<false>([&](IdT first, IdT end) {
+            for (IdT id = first; id < end; ++id) {
+                visitor(id);
+            }
+        });
+    }
+
+    /**
+     * @brief writes the used ids into out in ascending order.
+     * @throws std::invalid_argument if out is smaller than the number of used ids.
+     * @return the number of ids written.
+     */
+    std::size_t copy_used_ids(std::span<IdT> out) const {
+        id_generator_detail::check_batch_size(storage.size(), out);
+        std::size_t count = 0;
+        for_each_used([&](IdT id) { out[count++] = id; });
+        return count;
+    }
+
+    /**
+     * @brief returns the used ids, in ascending order if the storage iterates in order.
+     */
+    std::vector<IdT> get_used_ids() const {
+        std::vector<IdT> used_ids;
+        used_ids.reserve(storage.size());
+        storage.for_each([&](IdT id) { used_ids.push_back(id); });
+        return used_ids;
+    }
+
+    /**
+     * @brief returns the free ids in the order they will be handed out.
+     */
+    std::vector<IdT> get_free_ids() const
+        requires(Storage::bounded)
+    {
+        std::vector<IdT> free_ids;
+        free_ids.reserve(static_cast<std::size_t>(storage.capacity()) - storage.size());
+        if constexpr (reuse_from_storage) {
+            for_each_free([&](IdT id) { free_ids.push_back(id); });
+        } else {
+            reuse.for_each([&](IdT id) { free_ids.push_back(id); });
+            std::size_t reclaimed = free_ids.size();
+            for (const auto &[first, length] : free_ranges.intervals()) {
+                for (IdT offset = 0; offset < length; ++offset) {
+                    free_ids.push_back(first + offset);
+                }
+            }
+            if constexpr (ReusePolicy::compacts) {
+                std::inplace_merge(free_ids.begin(), free_ids.begin() + reclaimed, free_ids.end());
+            }
+            for (IdT id = next_id; id < storage.capacity(); ++id) {
+                free_ids.push_back(id);
+            }
+        }
+        return free_ids;
+    }
+
+    /**
+     * @note reads the storage directly, other threads should use get_stats instead.
+     */
+    double get_used_percentage() const
+        requires(Storage::bounded)
+    {
+        return (static_cast<double>(storage.size()) / static_cast<double>(storage.capacity())) * 100.0;
+    }
+
+    /**
+     * @brief streams the used ids as ascending runs, e.g. "Used IDs: [0-4095, 4100, 5000-5999]", followed by the used
+     * percentage for bounded storages.
+     * @param max_ranges the number of runs printed before the rest is elided as "...".
+     */
+    std::ostream &write_summary(std::ostream &os,
+                                std::size_t max_ranges = std::numeric_limits<std::size_t>::max()) const {
+        os << "Used IDs: [";
+        std::size_t printed = 0;
+        for (IdT first = next_id_from<true>(IdT(0), next_id); first != next_id; ++printed) {
+            if (printed == max_ranges) {
+                os << (printed == 0 ? "..." : ", ...");
+                break;
+            }
+            IdT end = run_end<true>(first, next_id);
+            os << (printed == 0 ? "" : ", ") << first;
+            if (end - first > 1) {
+                os << "-" << end - 1;
+            }
+            first = next_id_from<true>(end, next_id);
+        }
+        os << "]";
+        if constexpr (Storage::bounded) {
+            os << " | Used: " << get_used_percentage() << "%";
+        }
+        return os;
+    }
+
+    std::string to_string(std::size_t max_ranges = std::numeric_limits<std::size_t>::max()) const {
+        std::ostringstream ss;
+        write_summary(ss, max_ranges);
+        return ss.str();
+    }
+
+    friend std::ostream &operator<<(std::ostream &os, const basic_id_generator &generator) {
+        return generator.write_summary(os);
+    }
+
+    /**
+     * @brief writes the generator state in a versioned binary format.
+     * @details after a header identifying the id width and policies come the capacity, next_id, the reuse policy's
+     * own encoding and the free ranges. the used set is not stored since it is every id below next_id that is
+     * neither held by the reuse policy nor in a free range.
+     */
+    void save(std::ostream &os) const {
+        id_generator_detail::write_snapshot_header(os, snapshot_layout());
+        id_generator_detail::write_pod(os, storage.capacity());
+        id_generator_detail::write_pod(os, next_id);
+        if constexpr (reuse_from_storage) {
+            save_unused_words(os);
+        } else {
+            reuse.save(os);
+        }
+        id_generator_detail::write_intervals(os, free_ranges.intervals());
+    }
+
+    /**
+     * @brief replaces the generator state with one written by save, including the capacity and the reuse order.
+     * @throws std::runtime_error leaving the generator untouched if the stream is truncated or inconsistent.
+     */
+    void load(std::istream &is) {
+        id_generator_detail::read_snapshot_header(is, snapshot_layout());
+        IdT capacity = id_generator_detail::read_pod<IdT>(is);
+        IdT loaded_next_id = id_generator_detail::read_pod<IdT>(is);
+        bool next_id_in_range = id_generator_detail::in_range(loaded_next_id, capacity) || loaded_next_id == capacity;
+        if (!(capacity > 0) || !next_id_in_range) {
+            throw std::runtime_error("Corrupt id generator snapshot");
+        }
+
+        basic_id_generator loaded = [&] {
+            if constexpr (Storage::bounded) {
+                return basic_id_generator(capacity);
+            } else {
+                return basic_id_generator();
+            }
+        }();
+        loaded.next_id = loaded_next_id;
+        std::size_t limit = static_cast<std::size_t>(loaded_next_id);
+
+        std::vector<std::uint64_t> free_bits;
+        auto mark_free = [&](IdT id) {
+            std::size_t index = static_cast<std::size_t>(id);
+            std::uint64_t mask = std::uint64_t(1) << (index % 64);
+            if (free_bits[index / 64] & mask) {
+                throw std::runtime_error("Corrupt id generator snapshot");
+            }
+            free_bits[index / 64] |= mask;
+        };
+        if constexpr (reuse_from_storage) {
+            // the policy keeps nothing, the free ids below next_id were saved as lowest_free_reuse's words.
+            free_bits = id_generator_detail::read_bit_words(is, limit);
+        } else {
+            loaded.reuse.load(is, loaded_next_id);
+            free_bits.assign((limit + 63) / 64, 0);
+            loaded.reuse.for_each(mark_free);
+            if constexpr (requires { loaded.reuse.for_each_quarantined(mark_free); }) {
+                loaded.reuse.for_each_quarantined(mark_free);
+            }
+        }
+
+        std::uint64_t interval_count = id_generator_detail::read_pod<std::uint64_t>(is);
+        for (std::uint64_t i = 0; i < interval_count; ++i) {
+            IdT first = id_generator_detail::read_pod<IdT>(is);
+            IdT length = id_generator_detail::read_pod<IdT>(is);
+            if (!id_generator_detail::in_range(first, loaded_next_id) || !(length > 0) ||
+                length > loaded_next_id - first) {
+                throw std::runtime_error("Corrupt id generator snapshot");
+            }
+            for (IdT offset = 0; offset < length; ++offset) {
+                mark_free(first + offset);
+            }
+            loaded.add_free_range(first, length);
+        }
+
+        // the used ids are the clear bits of free_bits, storages that can take their complement whole do, the others
+        // get them a run at a time.
+        if constexpr (requires(std::span<const std::uint64_t> words) { loaded.storage.assign_words(words); }) {
+            for (std::uint64_t &word : free_bits) {
+                word = ~word;
+            }
+            if (limit % 64 != 0) {
+                free_bits.back() &= id_generator_detail::bit_mask(0, limit % 64);
+            }
+            loaded.storage.assign_words(free_bits);
+        } else {
+            std::size_t free_count = 0;
+            for (std::uint64_t word : free_bits) {
+                free_count += static_cast<std::size_t>(std::popcount(word));
+            }
+            loaded.storage.reserve(limit - free_count);
+            const std::uint64_t *bits = free_bits.data();
+            std::uint64_t set = ~std::uint64_t(0);
+            for (std::size_t first = id_generator_detail::find_next_bit(bits, 0, limit, set); first < limit;) {
+                std::size_t end = id_generator_detail::find_next_bit(bits, first, limit, 0);
+                loaded.storage.insert_range(static_cast<IdT>(first), static_cast<IdT>(end - first));
+                first = id_generator_detail::find_next_bit(bits, end, limit, set);
+            }
+        }
+
+        // the counters describe this generator's history, so they survive the load.
+        loaded.counters = counters;
+        *this = std::move(loaded);
+        record_levels();
+    }
+
+  private:
+    /**
+     * @brief whether the reuse policy keeps no ids and every unused id below next_id is free, see lowest_unused_reuse.
+     */
+    static constexpr bool reuse_from_storage = requires { requires ReusePolicy::derived_from_storage; };
+
+    /**
+     * @brief whether the reuse policy holds reclaimed ids in quarantine, they are then neither used nor free.
+     */
+    static constexpr bool quarantines = requires(const ReusePolicy &policy) {
+        policy.quarantined_count();
+        policy.quarantined_runs();
+    };
+
+    static constexpr std::uint32_t snapshot_layout() {
+        return (static_cast<std::uint32_t>(sizeof(IdT)) << 16) | (Storage::snapshot_tag << 8) |
+               ReusePolicy::snapshot_tag;
+    }
 
-class IDGenerator {
-  public:
-    virtual int get_id() = 0;
-    virtual void reclaim_id(int id) = 0;
-    virtual ~IDGenerator() {}
+    /**
+     * @brief keeps a free range in the reuse policy when it takes ranges, otherwise in free_ranges.
+     */
+    void add_free_range(IdT first, IdT n) {
+        if constexpr (requires { reuse.push_range(first, n); }) {
+            reuse.push_range(first, n);
+        } else {
+            free_ranges.insert(first, n);
+        }
+    }
+
+    /**
+     * @brief where the reuse policy hands back ranges it held, e.g. once their quarantine is over.
+     */
+    auto release_range() {
+        return [this](IdT first, IdT n) { add_free_range(first, n); };
+    }
+
+    bool has_reusable_id() const {
+        if constexpr (reuse_from_storage) {
+            return static_cast<std::size_t>(next_id) > storage.size();
+        } else {
+            return !reuse.empty() || !free_ranges.empty();
+        }
+    }
+
+    /**
+     * @brief the number of free ids below next_id.
+     */
+    std::size_t reusable_count() const {
+        if constexpr (reuse_from_storage) {
+            return static_cast<std::size_t>(next_id) - storage.size();
+        } else {
+            return reuse.size() + static_cast<std::size_t>(free_ranges.count());
+        }
+    }
+
+    /**
+     * @brief takes a reclaimed id, from the reuse policy before the free ranges unless the policy compacts, then both
+     * are lowest first and the lower of their fronts is taken. a policy derived from the storage only finds the
+     * lowest unused id, it stays free until it is inserted.
+     */
+    IdT pop_reusable_id() {
+        if constexpr (reuse_from_storage) {
+            IdT id = storage.next_unused(IdT(0), next_id);
+            drop_free_range_front(id);
+            return id;
+        } else if constexpr (ReusePolicy::compacts) {
+            if (!reuse.empty() && (free_ranges.empty() || reuse.front() < free_ranges.front())) {
+                return reuse.pop();
+            }
+        } else if (!reuse.empty()) {
+            return reuse.pop();
+        }
+        return free_ranges.pop();
+    }
+
+    /**
+     * @brief takes id out of free_ranges when a policy derived from the storage hands it out, as the lowest unused id
+     * it can only be the front of the lowest free range.
+     */
+    void drop_free_range_front(IdT id) {
+        if (!free_ranges.empty() && free_ranges.front() == id) {
+            free_ranges.pop();
+        }
+    }
+
+    IdT take_free_id() {
+        if (has_reusable_id()) {
+            return pop_reusable_id();
+        }
+        if (next_id >= storage.capacity()) {
+            counters.add_exhaustion_event();
+            throw std::runtime_error("Maximum ID limit reached");
+        }
+        return next_id++;
+    }
+
+    void prefetch_storage(IdT id) const {
+        if constexpr (requires { storage.prefetch(id); }) {
+            storage.prefetch(id);
+        }
+    }
+
+    /**
+     * @brief brings the counters and the published stats up to date after a change.
+     */
+    void record_levels() {
+        counters.raise_high_water_mark(static_cast<std::uint64_t>(next_id));
+        counters.set_free_list_depth(reusable_count());
+        stats.publish(storage.size(), quarantined_count(), static_cast<std::uint64_t>(next_id),
+                      static_cast<std::uint64_t>(storage.capacity()));
+    }
+
+    /**
+     * @brief lowers next_id past any free ids directly below it, a no-op for reuse policies that do not compact.
+     */
+    void compact() {
+        if constexpr (ReusePolicy::compacts) {
+            while (next_id > 0) {
+                IdT trimmed = free_ranges.trim_back(next_id);
+                if (trimmed == next_id) {
+                    trimmed = trim_reuse_back();
+                }
+                if (trimmed == next_id) {
+                    break;
+                }
+                next_id = trimmed;
+            }
+        }
+    }
+
+    /**
+     * @brief removes the free ids the reuse policy holds directly below next_id and returns the lowest of them, or
+     * next_id if there are none, policies that keep runs drop a whole run at once.
+     */
+    IdT trim_reuse_back() {
+        if constexpr (reuse_from_storage) {
+            IdT end = storage.used_end(next_id);
+            free_ranges.erase_from(end);
+            return end;
+        } else if constexpr (requires(ReusePolicy &policy, IdT end) { policy.trim_back(end); }) {
+            return reuse.trim_back(next_id);
+        } else if (reuse.contains(next_id - 1)) {
+            reuse.erase(next_id - 1);
+            return next_id - 1;
+        } else {
+            return next_id;
+        }
+    }
+
+    /**
+     * @brief the end of the ids iterated over, used ids are all below the high-water mark.
+     */
+    template <bool Used> IdT id_limit() const {
+        if constexpr (Used || !Storage::bounded) {
+            return next_id;
+        } else {
+            return storage.capacity();
+        }
+    }
+
+    /**
+     * @brief the lowest used (Used true) or free id in [from, limit), or limit if there is none. free ids are the
+     * unused ones outside the ascending interleaved (first, length) runs of skipped, quarantined, ids.
+     */
+    template <bool Used> IdT next_id_from(IdT from, IdT limit, const std::vector<IdT> &skipped = {}) const {
+        if constexpr (Used) {
+            return storage.next_used(from, limit);
+        } else {
+            IdT id = storage.next_unused(from, limit);
+            while (id != limit) {
+                IdT skipped_end = id_generator_detail::end_of_run(skipped, id);
+                if (skipped_end == id) {
+                    break;
+                }
+                id = storage.next_unused(std::min(skipped_end, limit), limit);
+            }
+            return id;
+        }
+    }
+
+    /**
+     * @brief the end of the run of used (Used true) or free ids starting at first, which stops at a skipped id.
+     */
+    template <bool Used> IdT run_end(IdT first, IdT limit, const std::vector<IdT> &skipped = {}) const {
+        if constexpr (Used) {
+            return storage.next_unused(first, limit);
+        } else {
+            return id_generator_detail::next_run_start(skipped, first, storage.next_used(first, limit));
+        }
+    }
+
+    /**
+     * @brief calls visitor(first, end) for every maximal run [first, end) of used (Used true) or free ids.
+     */
+    template <bool Used, typename RunVisitor> void for_each_run(RunVisitor visitor) const {
+        IdT limit = id_limit<Used>();
+        std::vector<IdT> skipped = Used ? std::vector<IdT>() : quarantined_runs();
+        for (IdT first = next_id_from<Used>(IdT(0), limit, skipped); first != limit;) {
+            IdT end = run_end<Used>(first, limit, skipped);
+            visitor(first, end);
+            first = next_id_from<Used>(end, limit, skipped);
+        }
+    }
+
+    /**
+     * @brief the quarantined ids as ascending interleaved (first, length) runs, which are neither used nor free.
+     */
+    std::vector<IdT> quarantined_runs() const {
+        if constexpr (quarantines) {
+            return reuse.quarantined_runs();
+        } else {
+            return {};
+        }
+    }
+
+    std::size_t quarantined_count() const {
+        if constexpr (quarantines) {
+            return reuse.quarantined_count();
+        } else {
+            return 0;
+        }
+    }
+
+    bool has_free_ids(std::size_t n) const {
+        std::size_t above_counter = static_cast<std::size_t>(storage.capacity() - next_id);
+        return n <= above_counter || n - above_counter <= reusable_count();
+    }
+
+    /**
+     * @brief writes the unused ids below next_id that are not in a free range as raw words, the encoding
+     * lowest_free_reuse saves, the free ranges follow as intervals.
+     */
+    void save_unused_words(std::ostream &os) const {
+        std::vector<std::uint64_t> free_words((static_cast<std::size_t>(next_id) + 63) / 64, 0);
+        for (IdT first = storage.next_unused(IdT(0), next_id); first != next_id;) {
+            IdT end = storage.next_used(first, next_id);
+            id_generator_detail::fill_bits(free_words.data(), static_cast<std::size_t>(first),
+                                           static_cast<std::size_t>(end), true);
+            first = storage.next_unused(end, next_id);
+        }
+        for (const auto &[first, length] : free_ranges.intervals()) {
+            id_generator_detail::fill_bits(free_words.data(), static_cast<std::size_t>(first),
+                                           static_cast<std::size_t>(first + length), false);
+        }
+        id_generator_detail::write_bit_words(os, free_words);
+    }
+
+    static constexpr std::size_t prefetch_distance = 16; ///< how far ahead batch calls prefetch the storage.
+
+    Storage storage;
+    [[no_unique_address]] ReusePolicy reuse;
+    IntervalFreeList<IdT> free_ranges; ///< ids released through free_range, unless the reuse policy keeps them.
+    IdT next_id = 0;                   ///< high-water mark, every id at or above it has never been handed out.
+    [[no_unique_address]] id_generator_detail::Counters<false> counters;
+    id_generator_detail::SeqlockStats stats; ///< on its own cache line so readers do not contend with the fields above.
 };
 
-class UniqueIDGenerator : public IDGenerator {
+using UniqueIDGenerator = basic_id_generator<int, fifo_reuse<int>, roaring_storage<int>>;
+/**
+ * @brief an unbounded generator that always hands out the smallest free id and shrinks its high-water mark back down
+ * when the top of the id space is free, keeping arrays indexed by id small.
+ */
+using DenseUniqueIDGenerator = basic_id_generator<int, lowest_free_reuse<int>, roaring_storage<int>>;
+/**
+ * @brief an unbounded generator that hands back the most recently reclaimed id first, for cache locality of pools
+ * indexed by id.
+ */
+using LifoUniqueIDGenerator = basic_id_generator<int, lifo_reuse<int>, roaring_storage<int>>;
+/**
+ * @brief an unbounded generator whose reclaimed ids are only reused, in FIFO order, after a configurable number of
+ * advance_epoch calls, e.g. QuarantinedUniqueIDGenerator generator(quarantined_reuse<fifo_reuse<int>>(3)).
+ */
+using QuarantinedUniqueIDGenerator = basic_id_generator<int, quarantined_reuse<fifo_reuse<int>>, roaring_storage<int>>;
+/**
+ * @brief an unbounded generator that hands out the smallest free id and keeps the reclaimed ids as merged intervals,
+ * for id spaces where most free ids sit in long runs, e.g. after a mass despawn.
+ */
+using IntervalUniqueIDGenerator = basic_id_generator<int, interval_reuse<int>, roaring_storage<int>>;
+/**
+ * @brief hands out ids in the range [0, max_value), reclaimed ones lowest first.
+ * @note construction is constant time, the used bitmap and its full word index are calloc'd. the lowest free id is
+ * found in the used bitmap itself, so it takes roughly one bit per id plus 1/64 for the index.
+ */
+using BoundedUniqueIDGenerator = basic_id_generator<int, lowest_unused_reuse<int>, bitmap_storage<int>>;
+
+/**
+ * @brief a UniqueIDGenerator split into shards that can be used from several threads at once.
+ *
+ * @details shard s owns the ids congruent to s modulo the shard count and hands them out from its own
+ * UniqueIDGenerator of local indices (id = local * shard_count + s), so shards never collide and each keeps its own
+ * reuse queue. every shard sits on its own cache line behind its own mutex, get_id only locks the calling thread's
+ * shard and reclaim_id only locks the shard owning the id, there is no global lock.
+ */
+class ShardedUniqueIDGenerator : public IDGenerator {
   public:
-    int get_id() override {
-        if (!reclaimed_ids.empty()) {
-            int id = reclaimed_ids.front();
-            reclaimed_ids.pop();
-            used_ids.insert(id);
-            return id;
+    explicit ShardedUniqueIDGenerator(std::size_t shard_count = std::max(1u, std::thread::hardware_concurrency()))
+        : shard_count(shard_count), shards(std::make_unique<Shard[]>(shard_count)) {
+        if (shard_count == 0) {
+            throw std::invalid_argument("shard_count must be greater than 0");
+        }
+    }
+
+    /**
+     * @brief hands out an id from the calling thread's shard, threads are assigned shards round robin.
+     */
+    int get_id() override { return get_id_from_shard(current_shard()); }
+
+    int get_id_from_shard(std::size_t shard_index) {
+        Shard &shard = shards[shard_index];
+        std::lock_guard lock(shard.mutex);
+        return to_global_id(shard, shard_index, shard.generator.get_id());
+    }
+
+    void get_ids(std::size_t n, std::span<int> out) override {
+        id_generator_detail::check_batch_size(n, out);
+        std::size_t shard_index = current_shard();
+        Shard &shard = shards[shard_index];
+        std::lock_guard lock(shard.mutex);
+        shard.generator.get_ids(n, out);
+        std::span<int> local_ids = out.first(n);
+        if (!std::all_of(local_ids.begin(), local_ids.end(),
+                         [&](int local_id) { return fits_global_id(shard_index, local_id); })) {
+            shard.generator.reclaim_ids(local_ids);
+            throw std::overflow_error("Shard " + std::to_string(shard_index) + " ran out of ids");
+        }
+        for (int &id : local_ids) {
+            id = static_cast<int>(id * shard_count + shard_index);
         }
-        int id = next_id++;
-        used_ids.insert(id);
-        return id;
     }
 
+    /**
+     * @brief returns the id to the shard that owns it, which need not be the calling thread's.
+     */
     void reclaim_id(int id_value) override {
-        if (used_ids.find(id_value) == used_ids.end()) {
+        if (id_value < 0) {
             throw std::invalid_argument("Invalid or already reclaimed ID");
         }
-        used_ids.erase(id_value);
-        reclaimed_ids.push(id_value);
+        Shard &shard = shards[id_value % shard_count];
+        std::lock_guard lock(shard.mutex);
+        shard.generator.reclaim_id(static_cast<int>(id_value / shard_count));
+    }
+
+    /**
+     * @brief returns the used ids of every shard, each shard is locked in turn so the result is not a snapshot across
+     * shards.
+     */
+    std::vector<int> get_used_ids() const {
+        std::vector<int> used_ids;
+        for (std::size_t shard_index = 0; shard_index < shard_count; ++shard_index) {
+            const Shard &shard = shards[shard_index];
+            std::lock_guard lock(shard.mutex);
+            for (int local_id : shard.generator.get_used_ids()) {
+                used_ids.push_back(static_cast<int>(local_id * shard_count + shard_index));
+            }
+        }
+        return used_ids;
     }
 
-    std::vector<int> get_used_ids() const { return std::vector<int>(used_ids.begin(), used_ids.end()); }
+    std::size_t get_shard_count() const { return shard_count; }
 
-    friend std::ostream &operator<<(std::ostream &os, const UniqueIDGenerator &generator) {
-        os << "Used IDs: [";
-        std::vector<int> ids = generator.get_used_ids();
-        for (size_t i = 0; i < ids.size(); ++i) {
-            os << ids[i];
-            if (i < ids.size() - 1) {
-                os << ", ";
+    /**
+     * @brief sums the counters of every shard without locking, the high-water mark is the bound on global ids.
+     */
+    IDGeneratorCounters get_counters() const {
+        IDGeneratorCounters total;
+        for (std::size_t shard_index = 0; shard_index < shard_count; ++shard_index) {
+            IDGeneratorCounters shard = shards[shard_index].generator.get_counters();
+            total.allocations += shard.allocations;
+            total.reclaims += shard.reclaims;
+            total.failed_reclaims += shard.failed_reclaims;
+            total.free_list_depth += shard.free_list_depth;
+            total.exhaustion_events += shard.exhaustion_events;
+            if (shard.high_water_mark > 0) {
+                std::uint64_t global_mark = (shard.high_water_mark - 1) * shard_count + shard_index + 1;
+                total.high_water_mark = std::max(total.high_water_mark, global_mark);
             }
         }
-        os << "]";
-        return os;
+        return total;
+    }
+
+    /**
+     * @brief sums the stats of every shard without locking, each shard is consistent on its own but the shards are
+     * read one after another.
+     */
+    IDGeneratorStats get_stats() const {
+        IDGeneratorStats total;
+        for (std::size_t shard_index = 0; shard_index < shard_count; ++shard_index) {
+            IDGeneratorStats shard = shards[shard_index].generator.get_stats();
+            total.used_count += shard.used_count;
+            total.quarantined_count += shard.quarantined_count;
+            if (shard.high_water_mark > 0) {
+                std::uint64_t global_mark = (shard.high_water_mark - 1) * shard_count + shard_index + 1;
+                total.high_water_mark = std::max(total.high_water_mark, global_mark);
+            }
+        }
+        total.capacity = static_cast<std::uint64_t>(std::numeric_limits<int>::max());
+        total.free_count = total.capacity - total.used_count - total.quarantined_count;
+        return total;
+    }
+
+    template <typename Logger>
+    void log_counters(Logger &logger, const std::string &name = "sharded id generator") const {
+        id_generator_detail::log_counters(logger, name, get_counters());
+    }
+
+  private:
+    struct alignas(cache_line_size) Shard {
+        mutable std::mutex mutex;
+        UniqueIDGenerator generator; ///< hands out local indices.
+    };
+
+    std::size_t current_shard() const { return id_generator_detail::thread_slot() % shard_count; }
+
+    bool fits_global_id(std::size_t shard_index, int local_id) const {
+        return static_cast<long long>(local_id) * shard_count + shard_index <=
+               static_cast<long long>(std::numeric_limits<int>::max());
+    }
+
+    /**
+     * @throws std::overflow_error after handing local_id back if the global id does not fit in an int.
+     */
+    int to_global_id(Shard &shard, std::size_t shard_index, int local_id) {
+        if (!fits_global_id(shard_index, local_id)) {
+            shard.generator.reclaim_id(local_id);
+            throw std::overflow_error("Shard " + std::to_string(shard_index) + " ran out of ids");
+        }
+        return static_cast<int>(local_id * shard_count + shard_index);
+    }
+
+    std::size_t shard_count;
+    std::unique_ptr<Shard[]> shards;
+};
+
+/**
+ * @brief an id together with the generation of its slot at the time it was handed out.
+ */
+struct GenerationalHandle {
+    std::uint32_t index = 0;
+    std::uint32_t generation = 0;
+
+    std::uint64_t to_bits() const { return (static_cast<std::uint64_t>(generation) << 32) | index; }
+    static GenerationalHandle from_bits(std::uint64_t bits) {
+        return {static_cast<std::uint32_t>(bits), static_cast<std::uint32_t>(bits >> 32)};
     }
 
-    int next_id = 0;
-    std::unordered_set<int> used_ids;
-    std::queue<int> reclaimed_ids;
+    bool operator==(const GenerationalHandle &other) const = default;
 };
 
-class BoundedUniqueIDGenerator : public IDGenerator {
+/**
+ * @brief hands out GenerationalHandle's on top of any id generator, so stale handles are rejected after their id has
+ * been reused.
+ *
+ * @details every slot has a generation counter that is bumped both when its id is handed out and when it is reclaimed,
+ * so live slots have an odd generation and a handle is valid exactly when its generation matches the slot's, one
+ * array compare with no hashing.
+ */
+template <typename Generator = UniqueIDGenerator> class GenerationalIDGenerator {
   public:
-    explicit BoundedUniqueIDGenerator(int max_value) : max_value(max_value), next_id(0) {
-        if (max_value <= 0) {
-            throw std::invalid_argument("max_value must be greater than 0");
+    explicit GenerationalIDGenerator(Generator generator = Generator()) : generator(std::move(generator)) {}
+
+    GenerationalHandle get_handle() {
+        int id = generator.get_id();
+        std::size_t index = static_cast<std::size_t>(id);
+        if (index >= generations.size()) {
+            generations.resize(index + 1, 0);
         }
+        return {static_cast<std::uint32_t>(id), ++generations[index]};
+    }
+
+    /**
+     * @brief whether the handle names a live slot, a default constructed or reclaimed handle has an even generation
+     * and is never valid.
+     */
+    bool is_valid(GenerationalHandle handle) const {
+        return (handle.generation & 1u) && handle.index < generations.size() &&
+               generations[handle.index] == handle.generation;
+    }
 
-        for (int i = 0; i < max_value; ++i) {
-            available_ids.push(i);
+    void reclaim_handle(GenerationalHandle handle) {
+        if (!is_valid(handle)) {
+            throw std::invalid_argument("Invalid or stale handle: " + std::to_string(handle.index) + "@" +
+                                        std::to_string(handle.generation));
         }
+        // bumped only once the generator took the id back, so a throwing reclaim leaves the handle valid.
+        generator.reclaim_id(static_cast<int>(handle.index));
+        ++generations[handle.index];
     }
 
+    const Generator &get_generator() const { return generator; }
+
+  private:
+    Generator generator;
+    std::vector<std::uint32_t> generations; ///< indexed by id, odd while the id is handed out.
+};
+
+/**
+ * @brief a BoundedUniqueIDGenerator that can be shared between threads without any locking.
+ *
+ * @details ids that were never handed out come from an atomic high-water counter, reclaimed ids are pushed on an index
+ * linked treiber stack whose head carries a tag that is bumped on every pop to rule out aba, and an atomic bitmap of
+ * used ids turns the double reclaim check into a single fetch_and.
+ */
+class ConcurrentBoundedIDGenerator : public IDGenerator {
+  public:
+    explicit ConcurrentBoundedIDGenerator(int max_value)
+        : max_value(validated_max_value(max_value)),
+          next_free(id_generator_detail::allocate_zeroed<std::uint32_t>(max_value)),
+          used_bits(id_generator_detail::allocate_zeroed<std::uint64_t>((max_value + 63) / 64)) {}
+
     int get_id() override {
-        if (available_ids.empty()) {
-            throw std::runtime_error("Maximum ID limit reached");
+        std::uint32_t index;
+        if (try_pop(index)) {
+            mark_used(index);
+            counters.add_allocations(1);
+            return static_cast<int>(index);
         }
 
-        int id = available_ids.front();
-        available_ids.pop();
-        used_ids.insert(id);
-        return id;
+        int id = next_id.load(std::memory_order_relaxed);
+        while (id < max_value) {
+            if (next_id.compare_exchange_weak(id, id + 1, std::memory_order_relaxed)) {
+                mark_used(id);
+                counters.add_allocations(1);
+                return id;
+            }
+        }
+        counters.add_exhaustion_event();
+        throw std::runtime_error("Maximum ID limit reached");
+    }
+
+    /**
+     * @brief claims as many of the n ids as possible from the counter with a single compare-exchange, the rest are
+     * popped from the free stack.
+     * @throws std::runtime_error after giving back whatever it took when fewer than n ids are free.
+     */
+    void get_ids(std::size_t n, std::span<int> out) override {
+        id_generator_detail::check_batch_size(n, out);
+        std::size_t taken = 0;
+        int id = next_id.load(std::memory_order_relaxed);
+        while (id < max_value) {
+            int block_end = static_cast<int>(std::min<std::size_t>(static_cast<std::size_t>(max_value), id + n));
+            if (next_id.compare_exchange_weak(id, block_end, std::memory_order_relaxed)) {
+                for (; id < block_end; ++id) {
+                    mark_used(id);
+                    out[taken++] = id;
+                }
+                break;
+            }
+        }
+
+        std::uint32_t index;
+        while (taken < n && try_pop(index)) {
+            mark_used(index);
+            out[taken++] = static_cast<int>(index);
+        }
+
+        if (taken < n) {
+            for (int taken_id : out.first(taken)) {
+                release(taken_id);
+            }
+            counters.add_exhaustion_event();
+            throw std::runtime_error("Maximum ID limit reached");
+        }
+        counters.add_allocations(n);
     }
 
     void reclaim_id(int id_value) override {
-        if (id_value < 0 || id_value >= max_value || used_ids.find(id_value) == used_ids.end()) {
+        if (id_value < 0 || id_value >= max_value || !release(id_value)) {
+            counters.add_failed_reclaim();
             throw std::invalid_argument("Invalid or already reclaimed ID: " + std::to_string(id_value));
         }
+        counters.add_reclaims(1);
+    }
+
+    int get_max_value() const { return max_value; }
 
-        used_ids.erase(id_value);
-        available_ids.push(id_value);
+    /**
+     * @brief whether id is currently handed out, a single wait-free load that is safe from any thread.
+     */
+    bool is_used(int id_value) const {
+        if (id_value < 0 || id_value >= max_value) {
+            return false;
+        }
+        return (std::atomic_ref(used_bits[id_value / 64]).load(std::memory_order_acquire) >> (id_value % 64)) & 1u;
     }
 
-    std::vector<int> get_free_ids() const {
-        std::vector<int> free_ids;
-        std::queue<int> temp_queue = available_ids;
-        while (!temp_queue.empty()) {
-            free_ids.push_back(temp_queue.front());
-            temp_queue.pop();
+    /**
+     * @brief sums the runtime counters, safe to call from any thread while the generator is in use.
+     * @details the free list depth is worked out from the other counters, so it is exact once the generator is quiet
+     * but can be off by the operations in flight while it is read.
+     */
+    IDGeneratorCounters get_counters() const {
+        IDGeneratorCounters values = counters.read();
+        if constexpr (id_generator_detail::counters_enabled) {
+            // the counter never moves back down, so it is its own high-water mark.
+            values.high_water_mark = static_cast<std::uint64_t>(next_id.load(std::memory_order_relaxed));
+            std::uint64_t in_use = values.allocations > values.reclaims ? values.allocations - values.reclaims : 0;
+            values.free_list_depth = values.high_water_mark > in_use ? values.high_water_mark - in_use : 0;
         }
-        return free_ids;
+        return values;
     }
 
-    std::vector<int> get_used_ids() const { return std::vector<int>(used_ids.begin(), used_ids.end()); }
+    template <typename Logger>
+    void log_counters(Logger &logger, const std::string &name = "concurrent id generator") const {
+        id_generator_detail::log_counters(logger, name, get_counters());
+    }
 
-    double get_used_percentage() const { return (static_cast<double>(used_ids.size()) / max_value) * 100.0; }
+  private:
+    static constexpr std::uint32_t empty_index = std::numeric_limits<std::uint32_t>::max();
 
-    std::string to_string() const {
-        std::ostringstream ss;
-        ss << "Used IDs: [";
-        std::vector<int> ids = get_used_ids();
-        for (size_t i = 0; i < ids.size(); ++i) {
-            ss << ids[i];
-            if (i < ids.size() - 1) {
-                ss << ", ";
+    static int validated_max_value(int max_value) {
+        if (max_value <= 0) {
+            throw std::invalid_argument("max_value must be greater than 0");
+        }
+        return max_value;
+    }
+
+    static std::uint64_t pack_head(std::uint32_t tag, std::uint32_t index) {
+        return (static_cast<std::uint64_t>(tag) << 32) | index;
+    }
+    static std::uint32_t head_index(std::uint64_t head) { return static_cast<std::uint32_t>(head); }
+    static std::uint32_t head_tag(std::uint64_t head) { return static_cast<std::uint32_t>(head >> 32); }
+
+    bool try_pop(std::uint32_t &index) {
+        std::uint64_t head = free_head.load(std::memory_order_acquire);
+        while (head_index(head) != empty_index) {
+            index = head_index(head);
+            std::uint32_t next = std::atomic_ref(next_free[index]).load(std::memory_order_relaxed);
+            if (free_head.compare_exchange_weak(head, pack_head(head_tag(head) + 1, next), std::memory_order_acquire,
+                                                std::memory_order_acquire)) {
+                return true;
             }
         }
-        ss << "] | Used: " << get_used_percentage() << "%";
-        return ss.str();
+        return false;
+    }
+
+    /**
+     * @brief clears the id's used bit and pushes it on the free stack.
+     * @return false without touching the stack if the id was not in use.
+     */
+    bool release(int id_value) {
+        std::uint64_t mask = std::uint64_t(1) << (id_value % 64);
+        std::uint64_t old_word = std::atomic_ref(used_bits[id_value / 64]).fetch_and(~mask, std::memory_order_acq_rel);
+        if (!(old_word & mask)) {
+            return false;
+        }
+
+        std::uint32_t index = static_cast<std::uint32_t>(id_value);
+        std::uint64_t head = free_head.load(std::memory_order_relaxed);
+        do {
+            std::atomic_ref(next_free[index]).store(head_index(head), std::memory_order_relaxed);
+        } while (!free_head.compare_exchange_weak(head, pack_head(head_tag(head), index), std::memory_order_release,
+                                                  std::memory_order_relaxed));
+        return true;
     }
 
-    friend std::ostream &operator<<(std::ostream &os, const BoundedUniqueIDGenerator &generator) {
-        return os << generator.to_string();
+    void mark_used(int id) {
+        std::atomic_ref(used_bits[id / 64]).fetch_or(std::uint64_t(1) << (id % 64), std::memory_order_release);
     }
 
-  private:
     int max_value;
-    int next_id;
-    std::queue<int> available_ids;
-    std::unordered_set<int> used_ids;
+    id_generator_detail::ZeroedArray<std::uint32_t> next_free; ///< the next link of every id on the free stack.
+    id_generator_detail::ZeroedArray<std::uint64_t> used_bits;
+    alignas(cache_line_size) std::atomic<int> next_id{0};
+    alignas(cache_line_size) std::atomic<std::uint64_t> free_head{pack_head(0, empty_index)};
+    [[no_unique_address]] id_generator_detail::ThreadCounters<16> counters; ///< a cache line per stripe when enabled.
 };
 
 /**
  * @brief A class for generating unique IDs.
- * @note This implementation is not thread-safe.
+ * @note get_id64 is a single lock-free fetch-add and is safe to call from any thread.
+ * @note when leasing is enabled with set_lease_block_size each thread reserves a block of ids with one fetch-add and
+ * hands them out without touching shared state, ids are then still globally unique but only increase monotonically
+ * within a thread.
+ * @note when persistence is enabled with enable_persistence an upper bound on the ids handed out is reserved in a
+ * journal file a block at a time, so after a crash or restart ids continue above anything handed out before.
  */
 class GlobalUIDGenerator {
   public:
     /**
      * @brief Retrieves the next unique ID.
-     * @return A unique integer ID.
+     * @return A unique 64-bit ID, the first one handed out is 1.
+     */
+    static std::uint64_t get_id64();
+    /**
+     * @brief legacy entry point kept for int based callers.
+     * @throws std::overflow_error once the next id no longer fits in an int.
      */
     static int get_id();
-    static int last_generated_id;
+    /**
+     * @brief enables thread local leasing of blocks of block_size ids, 0 (the default) disables it.
+     * @note a block already leased by a thread is used up before the new size takes effect for it, also when leasing
+     * is disabled with 0, and the unused part of a thread's block is given back on thread exit when no other block has
+     * been leased since, otherwise dropped.
+     */
+    static void set_lease_block_size(std::uint64_t block_size);
+    /**
+     * @brief resumes above the bound stored in the journal at journal_path (created if missing), from then on ids are
+     * only handed out once a bound at or above them has been written to the journal and fsync'd, reserving
+     * block_size ids per write.
+     * @throws std::runtime_error if the journal cannot be opened, or created and its directory synced, or exists
+     * without a valid record.
+     */
+    static void enable_persistence(const std::string &journal_path, std::uint64_t block_size = 100000);
+    /**
+     * @brief stops reserving ids in the journal and closes it.
+     */
+    static void disable_persistence();
+    /**
+     * @brief the id most recently handed out by any thread, it is not updated for leased ids.
+     */
+    alignas(cache_line_size) static std::atomic<std::uint64_t> last_generated_id;
+
+  private:
+    struct ThreadLease;
+
+    /**
+     * @brief hands out count consecutive ids and returns the first one.
+     */
+    static std::uint64_t reserve_ids(std::uint64_t count);
+    /**
+     * @brief blocks until the journal holds a bound at or above id.
+     */
+    static void persist_through(std::uint64_t id);
+
+    alignas(cache_line_size) static std::atomic<std::uint64_t> current_id; ///< tracks the last generated id.
+    alignas(cache_line_size) static std::atomic<std::uint64_t> lease_block_size;
+    /**
+     * @brief every id up to this one is covered by the journal, the maximum value when persistence is disabled so the
+     * hot path only needs this one comparison, and 0 while enable_persistence writes the first bound so ids reserved
+     * meanwhile wait for it.
+     */
+    alignas(cache_line_size) static std::atomic<std::uint64_t> persisted_bound;
+};
+
+/**
+ * @brief generates 64-bit ids that are unique across nodes and restarts and ordered by creation time.
+ *
+ * @details from the most significant bit down an id packs 41 bits of milliseconds since epoch_ms, 10 bits of node id
+ * and a 12 bit per millisecond sequence. the last (millisecond, sequence) pair handed out is kept in a single atomic,
+ * so get_id is a lock-free compare-exchange loop. if the clock goes backwards ids continue from the last millisecond
+ * handed out, and once a millisecond runs out of sequence numbers the next one is borrowed, so ids always increase.
+ */
+class SnowflakeIDGenerator {
+  public:
+    static constexpr int timestamp_bits = 41;
+    static constexpr int node_bits = 10;
+    static constexpr int sequence_bits = 12;
+    static constexpr std::uint64_t default_epoch_ms = 1577836800000; ///< 2020-01-01T00:00:00Z
+
+    /**
+     * @throws std::invalid_argument if node_id does not fit in node_bits.
+     */
+    explicit SnowflakeIDGenerator(std::uint32_t node_id, std::uint64_t epoch_ms = default_epoch_ms);
+
+    /**
+     * @throws std::overflow_error once the timestamp no longer fits in timestamp_bits, about 69 years after epoch_ms.
+     */
+    std::uint64_t get_id();
+
+    std::uint32_t get_node_id() const { return node_id; }
+    /**
+     * @brief returns the unix time in milliseconds encoded in an id handed out by this generator.
+     */
+    std::uint64_t get_timestamp_ms(std::uint64_t id) const { return (id >> (node_bits + sequence_bits)) + epoch_ms; }
 
   private:
-    static int current_id; ///< tracks the last generated id.
+    std::uint64_t milliseconds_since_epoch() const;
+
+    std::uint32_t node_id;
+    std::uint64_t epoch_ms;
+    alignas(cache_line_size) std::atomic<std::uint64_t> last_state{0}; ///< (milliseconds << sequence_bits) | sequence
 };
 
 #endif // UNIQUE_ID_GENERATOR_HPP